@@ -0,0 +1,98 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** @file animation.c */
+
+#include "pico/stdlib.h"
+
+#include "animation.h"
+
+/* ---------------------------------------------------------------------- */
+
+#define Q15_ONE 32768
+#define EASING_STEPS 16
+
+/*  Curve values at t = 0, 1/16, ... 1 in Q15, linearly interpolated between  */
+static const uint16_t easing_tables[][EASING_STEPS + 1] = {
+    [EASE_OUT] = {
+        0, 5768, 10816, 15192, 18944, 22120, 24768, 26936, 28672,
+        30024, 31040, 31768, 32256, 32552, 32704, 32760, 32768
+    },
+    [EASE_IN_OUT] = {
+        0, 32, 256, 864, 2048, 4000, 6912, 10976, 16384,
+        21792, 25856, 28768, 30720, 31904, 32512, 32736, 32768
+    },
+};
+
+/*  Latest end time of any tween started so far  */
+static uint32_t animation_end_us;
+
+/* ---------------------------------------------------------------------- */
+
+static uint32_t s_ease(easing_t easing, uint32_t t)
+{
+    if (easing == EASE_LINEAR || t >= Q15_ONE) {
+        return MIN(t, Q15_ONE);
+    }
+    const uint16_t *table = easing_tables[easing];
+    uint32_t step = t >> 11;          /*  Q15 / EASING_STEPS  */
+    uint32_t frac = t & 0x7ffu;
+    return table[step] + ( ( ( table[step + 1] - table[step] ) * frac ) >> 11 );
+}
+
+/* ---------------------------------------------------------------------- */
+
+void tween_start(tween_t *t, int16_t from, int16_t to, uint32_t duration_us,
+        easing_t easing)
+{
+    t->start_us = time_us_32();
+    t->duration_us = duration_us;
+    t->from = from;
+    t->to = to;
+    t->easing = easing;
+
+    uint32_t end_us = t->start_us + duration_us;
+    if ( !animation_running_p(t->start_us) || (int32_t) ( end_us - animation_end_us ) > 0 ) {
+        animation_end_us = end_us;
+    }
+} /* tween_start */
+
+bool tween_active_p(const tween_t *t, uint32_t now_us)
+{
+    return t->duration_us && now_us - t->start_us < t->duration_us;
+}
+
+int16_t tween_value(const tween_t *t, uint32_t now_us)
+{
+    if ( !tween_active_p(t, now_us) ) {
+        return t->to;
+    }
+    uint32_t progress = ( (uint64_t) ( now_us - t->start_us ) << 15 ) / t->duration_us;
+    int32_t span = t->to - t->from;
+    return t->from + ( span * (int32_t) s_ease(t->easing, progress) ) / Q15_ONE;
+}
+
+/** @brief `true` while any tween started through tween_start() is in flight.
+ *         The display task keeps its frame clock running until this goes false.
+ */
+bool animation_running_p(uint32_t now_us)
+{
+    return (int32_t) ( animation_end_us - now_us ) > 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ANIMATION_H
+#define __ANIMATION_H
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @file animation.h
+ *
+ *  @brief Time-based tweens for screen animations.
+ *
+ *  A tween is evaluated against the current time rather than stepped per frame,
+ *  so the display task can drop frames when it falls behind and the animation
+ *  still lands where (and when) it should.  All arithmetic is integer; progress
+ *  is Q15 and the easing curves are interpolated tables.
+ */
+
+typedef enum easing {
+    EASE_LINEAR,
+    EASE_OUT,     /**< Cubic ease-out:  fast start, gentle landing */
+    EASE_IN_OUT,  /**< Cubic ease-in-out */
+} easing_t;
+
+typedef struct tween {
+    uint32_t start_us;
+    uint32_t duration_us;
+    int16_t from;
+    int16_t to;
+    easing_t easing;
+} tween_t;
+
+void tween_start(tween_t *t, int16_t from, int16_t to, uint32_t duration_us,
+        easing_t easing);
+int16_t tween_value(const tween_t *t, uint32_t now_us);
+bool tween_active_p(const tween_t *t, uint32_t now_us);
+
+bool animation_running_p(uint32_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ANIMATION_H */
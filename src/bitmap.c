@@ -148,6 +148,21 @@ void bitmap_copy_from(bitmap_t *b, bitmap_t *source, uint32_t x, uint32_t y)
             );
 }
 
+/** @brief Copy all of `source` with its origin at (x, y), which may lie partly
+ *         or wholly outside `b`.  Pixels falling outside `b` are dropped.
+ */
+void bitmap_copy_from_offset(bitmap_t *b, bitmap_t *source, int32_t x, int32_t y)
+{
+    int32_t i_end = MIN( (int32_t) source->width, (int32_t) b->width - x );
+    int32_t j_end = MIN( (int32_t) source->height, (int32_t) b->height - y );
+
+    for (int32_t i = MAX(0, -x); i<i_end; i++) {
+        for (int32_t j = MAX(0, -y); j<j_end; j++) {
+            bitmap_draw_pixel( b, i + x, j + y, bitmap_pixel_value(source, i, j) );
+        }
+    }
+}
+
 void bitmap_draw_char(bitmap_t *b,
         uint32_t x,
         uint32_t y,
@@ -48,6 +48,7 @@ struct bitmap {
   bool (*pixel_value)(bitmap_t *, uint32_t x, uint32_t y);
   void (*clear)(bitmap_t *);
   void (*free_buffer)(bitmap_t *);
+  void (*show)(bitmap_t *);  /* Puts the bitmap on its device, NULL if it has none */
 
   void *buffer;
 };
@@ -62,11 +63,13 @@ void bitmap_draw_string(bitmap_t *, uint32_t x, uint32_t y, const struct bitmap_
 
 void bitmap_copy_from_bound(bitmap_t *, bitmap_t *, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
 void bitmap_copy_from(bitmap_t *, bitmap_t *, uint32_t x, uint32_t y);
+void bitmap_copy_from_offset(bitmap_t *, bitmap_t *, int32_t x, int32_t y);
 
 static inline void bitmap_invert(bitmap_t *b) { b->inverted = !b->inverted; }
 static inline void bitmap_clear(bitmap_t *b) { b->inverted = false; b->clear(b); }
 static inline void bitmap_draw_pixel(bitmap_t *b, uint32_t x, uint32_t y, bool value) { b->draw_pixel(b, x, y, value); }
 static inline bool bitmap_pixel_value(bitmap_t *b, uint32_t x, uint32_t y) { return b->pixel_value(b, x, y); }
+static inline void bitmap_show(bitmap_t *b) { if (b->show) b->show(b); }
 
 #ifdef __cplusplus
 }
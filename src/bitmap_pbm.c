@@ -0,0 +1,204 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** @file bitmap_pbm.c
+ *
+ * A screen backend for host builds, the harness in test/;  the firmware has
+ * no files to write to.  Frames are drawn into an SSD1306 buffer on the mock
+ * transport, as on the device, and every show is written out as a PBM image
+ * along with what it cost:  render time and the bytes that changed.
+ *
+ * SCREEN_PBM is the prefix of the files written.  Each panel gets a
+ * <prefix>panel<n>.csv of per-frame numbers and either one
+ * <prefix>panel<n>-<frame>.pbm per frame or, with SCREEN_PBM_STREAM, every
+ * frame appended to <prefix>panel<n>.pbm.  A file of concatenated PBM images
+ * is still valid netpbm, so either form can be fed to the usual tools.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "log.h"
+#include "bitmap.h"
+#include "bitmap_pbm.h"
+#include "ssd1306.h"
+
+#ifdef SCREEN_PBM
+
+typedef struct b_pbm {
+    bitmap_t *bitmap;
+    void (*ssd1306_clear)(bitmap_t *);
+    void (*ssd1306_show)(bitmap_t *);
+    uint8_t *previous;          /*  Buffer as of the last show  */
+    bool rendering;             /*  Cleared since the last show  */
+    uint32_t render_start_us;
+    FILE *frames;               /*  Only when streaming  */
+    FILE *csv;
+    pbm_stats_t stats;
+} b_pbm_t;
+
+static b_pbm_t pbm_panels[SCREEN_COUNT];
+static uint8_t pbm_panel_count;
+
+/* ---------------------------------------------------------------------- */
+
+static b_pbm_t *s_pbm_find(bitmap_t *b)
+{
+    for (uint8_t i = 0; i < pbm_panel_count; i++) {
+        if (pbm_panels[i].bitmap == b) {
+            return &pbm_panels[i];
+        }
+    }
+    panic("Bitmap is not a PBM panel");
+}
+
+/*  Lit pixels are white, as on the panel;  in PBM a set bit is black  */
+static void s_pbm_write(bitmap_t *b, FILE *f)
+{
+    uint8_t row[( b->width + 7 ) / 8];
+
+    fprintf(f, "P4\n%lu %lu\n", (unsigned long) b->width, (unsigned long) b->height);
+    for (uint32_t y = 0; y < b->height; y++) {
+        memset(row, 0, sizeof( row ));
+        for (uint32_t x = 0; x < b->width; x++) {
+            if ( !bitmap_pixel_value(b, x, y) ) {
+                row[x >> 3] |= 0x80u >> ( x & 7u );
+            }
+        }
+        fwrite(row, 1, sizeof( row ), f);
+    }
+}
+
+/* ---------------------------------------------------------------------- */
+
+/*  The first clear after a show is where rendering of the next frame starts  */
+static void s_pbm_clear(bitmap_t *b)
+{
+    b_pbm_t *pbm = s_pbm_find(b);
+
+    if (!pbm->rendering) {
+        pbm->rendering = true;
+        pbm->render_start_us = time_us_32();
+    }
+    pbm->ssd1306_clear(b);
+}
+
+static void s_pbm_show(bitmap_t *b)
+{
+    b_pbm_t *pbm = s_pbm_find(b);
+    ssd1306_t *disp = (ssd1306_t *) b->buffer;
+    pbm_stats_t *stats = &pbm->stats;
+    uint8_t panel = pbm - pbm_panels;
+
+    stats->render_us = pbm->rendering ? time_us_32() - pbm->render_start_us : 0;
+    stats->render_us_max = MAX(stats->render_us_max, stats->render_us);
+    pbm->rendering = false;
+
+    stats->changed_bytes = 0;
+    for (size_t i = 0; i < disp->bufsize; i++) {
+        stats->changed_bytes += disp->buffer[i] != pbm->previous[i];
+    }
+    memcpy(pbm->previous, disp->buffer, disp->bufsize);
+    stats->changed_bytes_total += stats->changed_bytes;
+
+    /*  Let the driver work out what it would have sent  */
+    ssd1306_mock_reset(disp);
+    pbm->ssd1306_show(b);
+    stats->sent_bytes = disp->mock_len + disp->mock_dropped;
+    stats->sent_bytes_total += stats->sent_bytes;
+
+    if (pbm->frames) {
+        s_pbm_write(b, pbm->frames);
+        fflush(pbm->frames);
+    } else {
+        char name[256];
+        snprintf(name, sizeof( name ), "%spanel%u-%06lu.pbm", SCREEN_PBM, panel,
+                (unsigned long) stats->frames
+                );
+        FILE *f = fopen(name, "wb");
+        if (f) {
+            s_pbm_write(b, f);
+            fclose(f);
+        } else {
+            log_error("Could not write %s", name);
+        }
+    }
+
+    if (pbm->csv) {
+        fprintf(pbm->csv, "%lu,%lu,%lu,%lu,%lu\n",
+                (unsigned long) stats->frames,
+                (unsigned long) time_us_32(),
+                (unsigned long) stats->render_us,
+                (unsigned long) stats->changed_bytes,
+                (unsigned long) stats->sent_bytes
+                );
+        fflush(pbm->csv);
+    }
+    stats->frames++;
+} /* s_pbm_show */
+
+/* ---------------------------------------------------------------------- */
+
+/** @brief custom_init for bitmap_alloc().  Panels are numbered in the order
+ *         they are allocated, which is the order b_ssd1306_alloc() sees them.
+ */
+void b_pbm_init(bitmap_t *b)
+{
+    char name[256];
+
+    assert(pbm_panel_count < SCREEN_COUNT);
+    uint8_t panel = pbm_panel_count++;
+    b_pbm_t *pbm = &pbm_panels[panel];
+
+    b_ssd1306_init(b);
+    ssd1306_t *disp = (ssd1306_t *) b->buffer;
+
+    pbm->bitmap = b;
+    pbm->ssd1306_clear = b->clear;
+    pbm->ssd1306_show = b->show;
+    pbm->previous = memset(pvPortMalloc(disp->bufsize), 0, disp->bufsize);
+
+    b->clear = s_pbm_clear;
+    b->show = s_pbm_show;
+
+#ifdef SCREEN_PBM_STREAM
+    snprintf(name, sizeof( name ), "%spanel%u.pbm", SCREEN_PBM, panel);
+    if ( !( pbm->frames = fopen(name, "wb") ) ) {
+        log_error("Could not write %s", name);
+    }
+#endif
+
+    snprintf(name, sizeof( name ), "%spanel%u.csv", SCREEN_PBM, panel);
+    if ( ( pbm->csv = fopen(name, "w") ) ) {
+        fprintf(pbm->csv, "frame,time_us,render_us,changed_bytes,sent_bytes\n");
+    } else {
+        log_error("Could not write %s", name);
+    }
+} /* b_pbm_init */
+
+const pbm_stats_t *b_pbm_stats(uint8_t panel)
+{
+    assert(panel < pbm_panel_count);
+    return &pbm_panels[panel].stats;
+}
+
+#endif /* SCREEN_PBM */
@@ -0,0 +1,53 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __BITMAP_PBM_H
+#define __BITMAP_PBM_H
+
+#include "pico/stdlib.h"
+
+#include "bitmap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Running totals for one panel dumped by the PBM backend
+ */
+typedef struct pbm_stats {
+    uint32_t frames;          /**< Frames shown */
+    uint32_t render_us;       /**< Last frame, from first clear to show */
+    uint32_t render_us_max;
+    uint32_t changed_bytes;   /**< Last frame, buffer bytes that differ from the frame before */
+    uint32_t sent_bytes;      /**< Last frame, bytes the panel transport would have sent */
+    uint64_t changed_bytes_total;
+    uint64_t sent_bytes_total;
+} pbm_stats_t;
+
+void b_pbm_init(bitmap_t *b);
+const pbm_stats_t *b_pbm_stats(uint8_t panel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BITMAP_PBM_H */
@@ -24,6 +24,9 @@
 
 #include "bitmap.h"
 #include "ssd1306.h"
+#ifdef SCREEN_PBM
+#include "bitmap_pbm.h"
+#endif
 
 static void b_ssd1306_clear(bitmap_t *b) {
   ssd1306_clear((ssd1306_t *)b->buffer);
@@ -37,21 +40,85 @@ static bool b_ssd1306_pixel_value(bitmap_t *b, uint32_t x, uint32_t y) {
   return ssd1306_pixel_value((ssd1306_t *)b->buffer, x, y);
 }
 
+static void b_ssd1306_show(bitmap_t *b) {
+  ssd1306_show_changes((ssd1306_t *)b->buffer);
+}
+
 static void b_ssd1306_free_buffer() {
   panic("Not implemented :(");
 }
 
+/*
+ * Logical panels.  Panel 0 is the SCREEN_... panel; more panels share its bus
+ * and are told apart by I2C address or SPI chip select.
+ */
+typedef struct {
+  uint8_t width;
+  uint8_t height;
+  uint8_t select;  /* I2C address, or SPI chip select pin */
+} b_ssd1306_panel_t;
+
+#ifdef SCREEN_SPI
+#define SCREEN_SELECT SCREEN_CS_PIN
+#define SCREEN_1_SELECT SCREEN_1_CS_PIN
+#else
+#define SCREEN_SELECT SCREEN_I2C_ADDRESS
+#define SCREEN_1_SELECT SCREEN_1_I2C_ADDRESS
+#endif
+
+static const b_ssd1306_panel_t panels[SCREEN_COUNT] = {
+  { SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_SELECT },
+#if SCREEN_COUNT > 1
+  { SCREEN_1_WIDTH, SCREEN_1_HEIGHT, SCREEN_1_SELECT },
+#endif
+};
+
+#if defined(SCREEN_PBM) && !defined(SCREEN_MOCK)
+#error "SCREEN_PBM draws on the mock transport, define SCREEN_MOCK as well"
+#endif
+
+/* The panel being set up by the b_ssd1306_init() in progress */
+static uint8_t init_panel;
+
 void b_ssd1306_init(bitmap_t *b) {
   ssd1306_t *disp = memset(pvPortMalloc(sizeof(ssd1306_t)),0,sizeof(ssd1306_t));
+  const b_ssd1306_panel_t *panel = &panels[init_panel];
 
   disp->external_vcc = false;
 
-  ssd1306_init(disp, SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_I2C_ADDRESS, SCREEN_I2C);
+#if defined(SCREEN_SPI)
+  ssd1306_init_spi(disp, panel->width, panel->height, SCREEN_SPI, panel->select, SCREEN_DC_PIN);
+#elif defined(SCREEN_MOCK)
+  ssd1306_init_mock(disp, panel->width, panel->height, SCREEN_MOCK);
+#else
+  ssd1306_init(disp, panel->width, panel->height, panel->select, SCREEN_I2C);
+#endif
 
   b->clear = b_ssd1306_clear;
   b->draw_pixel = b_ssd1306_draw_pixel;
   b->pixel_value = b_ssd1306_pixel_value;
   b->free_buffer = b_ssd1306_free_buffer;
+  b->show = b_ssd1306_show;
 
   b->buffer=disp;
 }
+
+bitmap_t *b_ssd1306_alloc(uint8_t panel) {
+  assert(panel < SCREEN_COUNT);
+  init_panel = panel;
+#ifdef SCREEN_PBM
+  return bitmap_alloc(panels[panel].width, panels[panel].height, b_pbm_init);
+#else
+  return bitmap_alloc(panels[panel].width, panels[panel].height, b_ssd1306_init);
+#endif
+}
+
+uint32_t b_ssd1306_panel_width(uint8_t panel) {
+  assert(panel < SCREEN_COUNT);
+  return panels[panel].width;
+}
+
+uint32_t b_ssd1306_panel_height(uint8_t panel) {
+  assert(panel < SCREEN_COUNT);
+  return panels[panel].height;
+}
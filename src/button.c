@@ -27,7 +27,9 @@
 /* pico-color-picker includes */
 #include "button.h"
 #include "context.h"
+#include "gesture.h"
 #include "input.h"
+#include "latency.h"
 #include "log.h"
 
 #define PIOx __CONCAT(pio, IO_DEVICES_PIO)
@@ -36,105 +38,60 @@
 
 /*  So far, we're just tracking the state of the buttons */
 
-uint8_t buttons;
-uint8_t buttons_depressed;
+uint32_t buttons;
+uint32_t buttons_depressed;
+
+static input_scan_t button_scan = INPUT_SCAN_INIT;
 
 static inline void button_register_button(uint8_t index)
 {
-    buttons |= 1 << index;
+    buttons |= 1u << index;
 }
 
+static __isr void button_decode(uint32_t pio_data, uint32_t time_us)
+{
+    uint32_t prior, now;
+    input_scan_word(&button_scan, pio_data, &prior, &now);
+
+    for (uint32_t changed = ( prior ^ now ) & buttons; changed; changed &= changed - 1) {
+        uint8_t i = __builtin_ctz(changed);
+        /* The pins are pulled up, so low is pressed */
+        input_ring_push(&input_events, time_us, INPUT_BUTTON, i, !( ( now >> i ) & 0x1u ));
+    }
+} /* button_decode */
+
+#ifndef INPUT_DMA
 static __isr void button_irq_handler(PIO pio, uint8_t sm, TaskHandle_t task_to_signal)
 {
-    uint32_t notify_bits = 0u;
+    uint32_t head = input_events.head;
     while ( pio_sm_get_rx_fifo_level(pio, sm) ) {
-        uint32_t pio_data = pio_sm_get(pio, sm);
-
-        for (int i = 0; i<8; i++) {
-            if ( !( buttons & ( 1 << i ) ) ) {
-                continue;
-            }
-
-            uint8_t prior_state, new_state;
-            prior_state = ( pio_data >> i ) & 0x1u;
-            new_state = ( pio_data >> ( 8 + i ) ) & 0x1u;
-
-            if (new_state ^ prior_state) {
-                uint32_t notify_temp = 1u;
-                notify_temp |= new_state ? 0 : 2u;
-                notify_bits |= notify_temp << ( i * 2 );
-            }
-        }
+        button_decode(pio_sm_get(pio, sm), time_us_32());
     }
 
-    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    xTaskNotifyIndexedFromISR(task_to_signal, 1,
-            notify_bits,
-            eSetBits,
-            &xHigherPriorityTaskWoken
-            );
-    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+    if (input_events.head != head) {
+        input_ring_notify_from_isr(task_to_signal);
+    }
 } /* button_irq_handler */
+#endif
 
-void button_task(void *parm)
+void button_event(context_t *context, const input_event_t *e)
 {
-    uint32_t bits = 0u;
-    context_t *context = NULL;
-
-    button_register_button(BUTTON_UPPER_OFFSET);
-    button_register_button(BUTTON_LOWER_OFFSET);
-    button_register_button(BUTTON_RED_OFFSET);
-    button_register_button(BUTTON_GREEN_OFFSET);
-    button_register_button(BUTTON_BLUE_OFFSET);
-    button_init(BUTTON_LOW_PIN, BUTTON_SM);
-
-    for ( ;;) {
-        /* Update the callbacks list if necessary */
-        do {
-            log_trace("Button checking context inbox.  Currently %p", context);
-            xTaskNotifyWaitIndexed(NTFCN_IDX_CONTEXT,
-                    0u,
-                    0u,
-                    (uint32_t *) &context,
-                    context? 0 : portMAX_DELAY
-                    );
-            log_trace("Button context set to: %p", context);
-        } while ( !context );
-
-        ASSERT_IS_A(context, CONTEXT_T);
-
-        for (int i = 0; context && i<8 && bits; i++, bits >>= 2) {
-            if ( !( bits & 1u ) ) {
-                continue;
-            }
-            if (bits & 2u) {
-                buttons_depressed |= 1 << i;
-            } else {
-                buttons_depressed &= ~( 1 << i );
-            }
-            context_callback_t *c = context_get_button_callback(context, i);
-            if (c->callback) {
-                log_trace("Button %d executing callback %lx", i, c->callback);
-                c->callback( context, c->data, (v32_t) ( bits & 2u ) );
-            } else {
-                log_trace("No callback for button %d", i);
-            }
-        }
-
-        /* TODO:  It's possible the context has switched.  If that's the case
-         *        do we still want to handle the callbacks like this?
-         */
-
-        context = context_current();
-        context_callback_t *d = context_get_display_callback(context);
-        if (d) {
-            d->callback(context, d->data, (v32_t) 0ul);
-        }
-
-        while ( !xTaskNotifyWaitIndexed(1, 0u, 0xFFFFFFFFu, &bits, portMAX_DELAY) ) {;}
-        log_trace("Button event received: %lx", bits);
+    uint8_t i = e->device;
+    if (e->value) {
+        buttons_depressed |= 1u << i;
+    } else {
+        buttons_depressed &= ~( 1u << i );
+    }
+    context_callback_t *c = context_get_button_callback(context, i);
+    if (c->callback) {
+        log_trace("Button %d executing callback %lx", i, c->callback);
+        latency_input(e->time_us);
+        c->callback( context, c->data, (v32_t) (uint32_t) ( e->value ? 2u : 0u ) );
+    } else {
+        log_trace("No callback for button %d", i);
     }
-} /* button_task */
+    gesture_button(context, e);
+} /* button_event */
 
 void button_return_callback(context_t *c, void *data, v32_t value)
 {
@@ -146,15 +103,33 @@ void button_return_callback(context_t *c, void *data, v32_t value)
 
 void button_init(uint8_t low_pin, uint8_t sm)
 {
+    button_register_button(BUTTON_UPPER_OFFSET);
+    button_register_button(BUTTON_LOWER_OFFSET);
+    button_register_button(BUTTON_RED_OFFSET);
+    button_register_button(BUTTON_GREEN_OFFSET);
+    button_register_button(BUTTON_BLUE_OFFSET);
+
     log_trace("Initializing buttons on SM %d", sm);
-    for (uint8_t b = 0; b<8; b++) {
-        if ( buttons & ( 1 << b ) ) {
+#ifdef INPUT_SHIFT_REGISTERS
+    /* Every button on the chain is read */
+    for (uint8_t b = 0; b<BUTTON_COUNT; b++) {
+        button_register_button(b);
+    }
+    input_init_shift_sm(BUTTON_SR_LOAD_PIN, BUTTON_SR_DATA_PIN, sm, BUTTON_COUNT);
+#else
+    for (uint8_t b = 0; b<BUTTON_COUNT; b++) {
+        if ( buttons & ( 1u << b ) ) {
             input_init_pin(low_pin + b);
         }
     }
-    input_init_sm(low_pin, sm);
+    input_init_sm(low_pin, sm, BUTTON_STABLE_SAMPLES);
+#endif
+#ifdef INPUT_DMA
+    input_dma_capture(PIOx, sm, button_decode);
+#else
     input_pio_irq_set_handler(PIOx, sm,
             button_irq_handler, xTaskGetCurrentTaskHandle(),
             PIO_INTR_SM0_RXNEMPTY_BITS
             );
+#endif
 } /* button_init */
@@ -24,14 +24,15 @@
 #include "pico/stdlib.h"
 
 #include "context.h"
+#include "input.h"
 
-extern uint8_t buttons;
-extern uint8_t buttons_depressed;
+extern uint32_t buttons;
+extern uint32_t buttons_depressed;
 
-inline bool button_depressed_p(uint8_t index) { assert(index<8); return buttons_depressed & (1<<index); }
+inline bool button_depressed_p(uint8_t index) { assert(index<BUTTON_COUNT); return buttons_depressed & (1u<<index); }
 
-void button_task(void *parm);
 void button_init(uint8_t pin, uint8_t sm);
+void button_event(context_t *context, const input_event_t *e);
 void button_return_callback(context_t *c, void *data, v32_t value);
 
 #endif /* __BUTTON_H */
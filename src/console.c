@@ -0,0 +1,177 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** @file console.c
+ *
+ */
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "console.h"
+#include "context.h"
+#include "input_record.h"
+#include "latency.h"
+#include "ws281x.h"
+
+#ifdef USB_CONSOLE
+
+#define CONSOLE_POLL_US 100000
+#define CONSOLE_LOAD_TIMEOUT_US 10000000  /* Give up on a paste that stops */
+#define CONSOLE_LINE_LENGTH 128
+
+static void s_console_help()
+{
+    printf("?  this help\n");
+    printf("d  display statistics and task stack headroom\n");
+    printf("m  LED current estimate and limiter\n");
+#ifdef LATENCY_STATS
+    printf("l  latency histograms (us)\n");
+    printf("L  reset the latency histograms\n");
+#endif
+#ifdef INPUT_RECORD
+    printf("r  record input events\n");
+    printf("s  stop recording or replaying\n");
+    printf("w  write out the recording\n");
+    printf("u  load a recording written out earlier:  paste it, REC to END\n");
+    printf("p  replay the recording (P: four times faster)\n");
+#endif
+}
+
+static void s_console_display_stats()
+{
+    const display_stats_t *s = context_display_stats();
+    printf("frames %lu dropped %lu invalidations %lu coalesced %lu\n",
+            s->frames, s->frames_dropped, s->invalidations, s->invalidations_coalesced
+            );
+    printf("render %lu us (max %lu) transfer %lu us (max %lu)\n",
+            s->render_us, s->render_us_max, s->transfer_us, s->transfer_us_max
+            );
+    printf("stack headroom (words) input %lu display %lu leds %lu console %lu\n",
+            (unsigned long) uxTaskGetStackHighWaterMark(tasks.input),
+            (unsigned long) uxTaskGetStackHighWaterMark(tasks.display),
+            (unsigned long) uxTaskGetStackHighWaterMark(tasks.leds),
+            (unsigned long) uxTaskGetStackHighWaterMark(NULL)
+            );
+}
+
+static void s_console_power_stats()
+{
+    const ws281x_power_stats_t *s = ws281x_power_stats();
+    printf("LEDs %lu mA (max %lu) of %lu, unlimited %lu mA\n",
+            s->drawn_ma, s->drawn_ma_max, s->budget_ma, s->estimate_ma
+            );
+    printf("limiter %u/256, %lu frames limited\n", s->scale, s->limited_frames);
+}
+
+#ifdef INPUT_RECORD
+static void s_console_load()
+{
+    char line[CONSOLE_LINE_LENGTH];
+    size_t len = 0;
+    input_load_t status = INPUT_LOAD_MORE;
+
+    printf("Paste the recording\n");
+    input_load_start();
+    while (status == INPUT_LOAD_MORE) {
+        int c = getchar_timeout_us(CONSOLE_LOAD_TIMEOUT_US);
+        if (c == PICO_ERROR_TIMEOUT) {
+            input_load_abort();
+            printf("Load timed out\n");
+            return;
+        }
+        if (c != '\r' && c != '\n' && len + 1 < sizeof( line )) {
+            line[len++] = c;
+            continue;
+        }
+        line[len] = '\0';
+        status = input_load_line(line);
+        len = 0;
+        if (c != '\r' && c != '\n') {
+            line[len++] = c;  /* Dump lines fit;  a longer line is split here */
+        }
+    }
+    if (status == INPUT_LOAD_DONE) {
+        printf("Loaded %lu records\n", input_record_count());
+    } else {
+        printf("Load failed\n");
+    }
+} /* s_console_load */
+#endif
+
+void console_task(void *parm)
+{
+    for ( ;;) {
+        int c = getchar_timeout_us(CONSOLE_POLL_US);
+        switch (c) {
+        case PICO_ERROR_TIMEOUT:
+            break;
+        case 'd':
+            s_console_display_stats();
+            break;
+        case 'm':
+            s_console_power_stats();
+            break;
+#ifdef LATENCY_STATS
+        case 'l':
+            latency_report();
+            break;
+        case 'L':
+            latency_reset();
+            printf("Latency histograms reset\n");
+            break;
+#endif
+#ifdef INPUT_RECORD
+        case 'r':
+            input_record_start();
+            printf("Recording\n");
+            break;
+        case 's':
+            input_record_stop();
+            input_replay_stop();
+            printf("Stopped with %lu records\n", input_record_count());
+            break;
+        case 'w':
+            input_record_dump(stdout);
+            break;
+        case 'u':
+            s_console_load();
+            break;
+        case 'p':
+        case 'P':
+            input_replay_start(c == 'P' ? 4 : 1);
+            printf("Replaying %lu records\n", input_record_count());
+            break;
+#endif
+        case '\r':
+        case '\n':
+            break;
+        default:
+            s_console_help();
+            break;
+        }
+    }
+} /* console_task */
+
+#endif /* USB_CONSOLE */
@@ -27,7 +27,9 @@
 #include "queue.h"
 
 #include "pcp.h"
+#include "animation.h"
 #include "context.h"
+#include "latency.h"
 #include "log.h"
 #include "ssd1306.h"
 #include "ws281x.h"
@@ -43,6 +45,28 @@ typedef struct context_frame {
 
 static QueueHandle_t context_stack;
 
+/*  Everything the display task keeps per logical panel  */
+typedef struct panel {
+    bitmap_t *screen;
+    bitmap_t *slide_buffers[2]; /*  Outgoing and incoming frames  */
+    context_t *context;         /*  Context shown on this panel  */
+    context_t *last_context;    /*  Context rendered in the last frame  */
+    tween_t slide;
+    int8_t slide_direction;
+    uint32_t last_depth;
+    bool dirty;                 /*  Needs a render and flush  */
+} panel_t;
+
+static display_stats_t display_stats;
+
+/*  Latest context posted for each panel, taken by the display task  */
+static context_t *panel_posts[SCREEN_COUNT];
+
+/* ---------------------------------------------------------------------- */
+
+#define CONTEXT_SLIDE_ANIMATION_US 200000
+#define FRAME_PERIOD_US ( 1000000 / DISPLAY_FRAME_RATE )
+
 /* ---------------------------------------------------------------------- */
 
 static void s_context_enable(context_t *c)
@@ -53,24 +77,38 @@ static void s_context_enable(context_t *c)
                 (v32_t) 0ul
                 );
     }
-    if (tasks.rotary_encoders) {
-        xTaskNotifyIndexed(tasks.rotary_encoders, NTFCN_IDX_CONTEXT,
-                (uint32_t) c, eSetValueWithOverwrite
-                );
-    }
-    if (tasks.buttons) {
-        xTaskNotifyIndexed(tasks.buttons, NTFCN_IDX_CONTEXT, (uint32_t) c,
+    if (tasks.input) {
+        xTaskNotifyIndexed(tasks.input, NTFCN_IDX_CONTEXT, (uint32_t) c,
                 eSetValueWithOverwrite
                 );
     }
     context_notify_display_task(c);
 } /* s_context_enable */
 
+/** @brief Mark the display out of date.  Any number of calls within a frame
+ *         period result in one render, of the latest state, on the display task.
+ */
+void context_notify_display_task(context_t *c)
+{
+    taskENTER_CRITICAL();
+    display_stats.invalidations++;
+    panel_posts[c->panel] = c;
+    taskEXIT_CRITICAL();
+    xTaskNotifyIndexed(tasks.display, NTFCN_IDX_EVENT, 1u << c->panel, eSetBits);
+}
+
 void context_set_button_char(context_t *c, uint8_t offset, int16_t v)
 {
     c->button_chars[offset] = v;
 }
 
+void context_set_re_label(context_t *c, uint8_t re_offset, const char *label)
+{
+    assert(re_offset < RE_COUNT);
+    strncpy(c->re_labels[re_offset], label, RE_LABEL_LEN);
+    c->re_labels[re_offset][RE_LABEL_LEN] = '\0';
+}
+
 bitmap_t *context_get_drawing_pane(context_t *c)
 {
     return ( c ?: context_current() )->pane;
@@ -78,7 +116,7 @@ bitmap_t *context_get_drawing_pane(context_t *c)
 
 context_callback_t *context_get_button_callback(context_t *c, uint8_t i)
 {
-    assert(i < IO_PIO_SLOTS);
+    assert(i < BUTTON_COUNT);
     return &c->button_ccb[i];
 }
 
@@ -104,10 +142,12 @@ void context_builder_init()
     context_t *context = pcp_zero_malloc( sizeof( context_t ) );
     context->pcp.magic_number = CONTEXT_T;
     context->pcp.free_f = context_free;
-    for (uint8_t i = 0; i<IO_PIO_SLOTS; i++) {
+    for (uint8_t i = 0; i<BUTTON_COUNT; i++) {
         context->button_chars[i] = 32;
     }
-    context->pane = bitmap_alloc(RE_LABEL_TOTAL_WIDTH, SCREEN_HEIGHT, NULL);
+    context->pane = bitmap_alloc(RE_LABEL_TOTAL_WIDTH( b_ssd1306_panel_width(0) ),
+            b_ssd1306_panel_height(0), NULL
+            );
     vTaskSetThreadLocalStoragePointer(NULL, ThLS_BLDR_CTX, context);
 } /* context_builder_init */
 
@@ -115,7 +155,7 @@ void context_builder_set_re_label(uint8_t re_offset, const char *label)
 {
     context_t *c = (context_t *) pvTaskGetThreadLocalStoragePointer(NULL, ThLS_BLDR_CTX);
     ASSERT_IS_A(c, CONTEXT_T);
-    assert(re_offset < IO_PIO_SLOTS / 2);
+    assert(re_offset < RE_COUNT);
 
     if (label) {
         strncat(c->re_labels[re_offset], label, RE_LABEL_LEN);
@@ -129,7 +169,7 @@ void context_builder_set_re(uint8_t re_offset, uint8_t button_offset,
 {
     context_t *c = (context_t *) pvTaskGetThreadLocalStoragePointer(NULL, ThLS_BLDR_CTX);
     ASSERT_IS_A(c, CONTEXT_T);
-    assert(re_offset < IO_PIO_SLOTS / 2);
+    assert(re_offset < RE_COUNT);
 
     c->re_ccb[re_offset].callback = re_callback;
     c->re_ccb[re_offset].data = re_data;
@@ -150,6 +190,34 @@ void context_builder_set_button(uint8_t offset, context_callback_f callback,
     c->button_chars[offset] = label;
 }
 
+void context_builder_set_gesture(uint8_t offset, context_callback_f callback,
+        void *data)
+{
+    context_t *c = (context_t *) pvTaskGetThreadLocalStoragePointer(NULL, ThLS_BLDR_CTX);
+    ASSERT_IS_A(c, CONTEXT_T);
+    assert(offset < BUTTON_COUNT);
+
+    c->gesture_ccb[offset].callback = callback;
+    c->gesture_ccb[offset].data = data;
+}
+
+void context_builder_add_combo(uint32_t buttons, context_callback_f callback,
+        void *data)
+{
+    context_t *c = (context_t *) pvTaskGetThreadLocalStoragePointer(NULL, ThLS_BLDR_CTX);
+    ASSERT_IS_A(c, CONTEXT_T);
+
+    for (uint8_t i = 0; i < CONTEXT_COMBOS; i++) {
+        if (!c->combos[i].buttons) {
+            c->combos[i].buttons = buttons;
+            c->combos[i].ccb.callback = callback;
+            c->combos[i].ccb.data = data;
+            return;
+        }
+    }
+    assert(false); /* Raise CONTEXT_COMBOS */
+}
+
 void context_builder_set_enable_callback(context_callback_f callback,
         void *data)
 {
@@ -172,6 +240,33 @@ void context_builder_set_display_callback(context_callback_f callback,
     c->display_ccb.data = data;
 }
 
+/** @brief Let fast spins reach the encoder callbacks as larger deltas */
+void context_builder_set_re_acceleration(bool accelerated)
+{
+    context_t *c = (context_t *) pvTaskGetThreadLocalStoragePointer(NULL,
+            ThLS_BLDR_CTX
+            );
+    ASSERT_IS_A(c, CONTEXT_T);
+    c->re_accelerated = accelerated;
+}
+
+/** @brief Show the context on another logical panel.  The drawing pane is
+ *         resized to suit, so call this before handing the pane out.
+ */
+void context_builder_set_panel(uint8_t panel)
+{
+    context_t *c = (context_t *) pvTaskGetThreadLocalStoragePointer(NULL,
+            ThLS_BLDR_CTX
+            );
+    ASSERT_IS_A(c, CONTEXT_T);
+    assert(panel < SCREEN_COUNT);
+    c->panel = panel;
+    pcp_free(c->pane);
+    c->pane = bitmap_alloc(RE_LABEL_TOTAL_WIDTH( b_ssd1306_panel_width(panel) ),
+            b_ssd1306_panel_height(panel), NULL
+            );
+}
+
 void context_builder_set_data(void *data)
 {
     context_t *c = (context_t *) pvTaskGetThreadLocalStoragePointer(NULL,
@@ -203,81 +298,195 @@ context_t *context_builder_finalize()
 
 /* ---------------------------------------------------------------------- */
 
+static void s_context_compose(bitmap_t *screen, context_t *c)
+{
+    bitmap_clear(c->pane);
+    c->display_ccb.callback(c, c->display_ccb.data, (v32_t) 0ul);
+
+    /* If an assert fails in the xSemaphoreTake, it likely means the ContextScreen is corrupt */
+    bitmap_clear(screen);
+
+    uint32_t label_y = RE_LABEL_Y_OFFSET(screen->height);
+    uint32_t label_width = RE_LABEL_TOTAL_WIDTH(screen->width);
+
+    bitmap_copy_from_bound(screen, c->pane, 0, 0, c->pane->width,
+            c->use_labels ? label_y : c->pane->height
+            );
+    if (c->use_labels) {
+        bitmap_draw_string(screen, 0, label_y,
+                &TRIPLE_LINE_TEXT_FONT, c->re_labels[re_offsets[0]]
+                );
+        bitmap_draw_string(screen,
+                ( label_width - TRIPLE_LINE_TEXT_FONT.Width *
+                  strnlen(c->re_labels[re_offsets[2]],
+                          8
+                          ) ) / 2,
+                label_y,
+                &TRIPLE_LINE_TEXT_FONT,
+                c->re_labels[re_offsets[1]]
+                );
+        bitmap_draw_string(screen,
+                label_width - TRIPLE_LINE_TEXT_FONT.Width *
+                strnlen(c->re_labels[re_offsets[2]],8),
+                label_y, &TRIPLE_LINE_TEXT_FONT, c->re_labels[re_offsets[2]]
+                );
+    }
+
+    /*
+     * Draw the chevrons if they're there
+     */
+    bitmap_draw_char(screen, label_width, 0,
+            &BUTTON_LABEL_FONT, c->button_chars[0]
+            );
+    bitmap_draw_char(screen, label_width,
+            BUTTON_LABEL_FONT.Height, &BUTTON_LABEL_FONT, c->button_chars[1]
+            );
+} /* s_context_compose */
+
+/*  Render a panel's context and send whatever changed.  Returns the render time.  */
+static uint32_t s_panel_render(panel_t *p, uint32_t now_us)
+{
+    context_t *c = p->context;
+    ssd1306_t *disp = (ssd1306_t *) p->screen->buffer;
+
+    /*  A scroll only means something relative to what this context last drew  */
+    taskENTER_CRITICAL();
+    int8_t scroll_pages = c->scroll_pages;
+    c->scroll_pages = 0;
+    taskEXIT_CRITICAL();
+
+    uint32_t depth = context_stack_depth();
+    if (c == p->last_context) {
+        ssd1306_scroll(disp, scroll_pages);
+    } else if (p->last_context) {
+        /*  Slide the new context in over the last frame of the old one  */
+        p->slide_direction = depth < p->last_depth ? -1 : 1;
+        bitmap_copy_from(p->slide_buffers[0], p->screen, 0, 0);
+        tween_start(&p->slide, p->slide_direction * p->screen->width, 0,
+                CONTEXT_SLIDE_ANIMATION_US, EASE_IN_OUT
+                );
+    }
+    p->last_context = c;
+    p->last_depth = depth;
+    latency_mark(LATENCY_OUTPUT_DISPLAY, LATENCY_RENDER_START);
+
+    if ( tween_active_p(&p->slide, now_us) ) {
+        int16_t x = tween_value(&p->slide, now_us);
+        s_context_compose(p->slide_buffers[1], c);
+        bitmap_clear(p->screen);
+        bitmap_copy_from_offset(p->screen, p->slide_buffers[0],
+                x - p->slide_direction * p->screen->width, 0
+                );
+        bitmap_copy_from_offset(p->screen, p->slide_buffers[1], x, 0);
+    } else {
+        s_context_compose(p->screen, c);
+    }
+
+    uint32_t render_us = time_us_32() - now_us;
+    latency_mark(LATENCY_OUTPUT_DISPLAY, LATENCY_RENDER_END);
+    bitmap_show(p->screen);
+    latency_mark(LATENCY_OUTPUT_DISPLAY, LATENCY_PANEL);
+    p->dirty = false;
+    return render_us;
+} /* s_panel_render */
+
+const display_stats_t *context_display_stats()
+{
+    return &display_stats;
+}
+
 void context_display_task(void *parm)
 {
-    static bitmap_t *screen_buffer;
-    static context_t *c;
-    static context_leds_t *leds;
+    static panel_t panels[SCREEN_COUNT];
+    static uint32_t next_frame_us;
+    static uint32_t rendered_invalidations;
 
     /*  The screen needs a little time to warm up  */
     vTaskDelay(400 / portTICK_PERIOD_MS);
 
-    if (!screen_buffer) {
-        screen_buffer = bitmap_alloc(SCREEN_WIDTH, SCREEN_HEIGHT, b_ssd1306_init);
+    for (uint8_t i = 0; i < SCREEN_COUNT; i++) {
+        panel_t *p = &panels[i];
+        if (!p->screen) {
+            p->screen = b_ssd1306_alloc(i);
+            p->slide_buffers[0] = bitmap_alloc(p->screen->width, p->screen->height, NULL);
+            p->slide_buffers[1] = bitmap_alloc(p->screen->width, p->screen->height, NULL);
+        }
+        bitmap_clear(p->screen);
+        ssd1306_show( (ssd1306_t *) p->screen->buffer );
     }
 
-    bitmap_clear(screen_buffer);
-    ssd1306_show( (ssd1306_t *) screen_buffer->buffer );
-
     for ( ;;) {
-        while ( !xTaskNotifyWaitIndexed(NTFCN_IDX_EVENT, 0u, 0xFFFFFFFFu,
-                (uint32_t *) ( &c ), portMAX_DELAY
-                ) ) {
-            ;
+        /*  Sleep until the next event or, while anything is animating, the next frame  */
+        TickType_t wait = portMAX_DELAY;
+        if ( animation_running_p( time_us_32() ) ) {
+            int32_t until_us = next_frame_us - time_us_32();
+            wait = until_us > 0 ? pdMS_TO_TICKS( ( until_us + 999 ) / 1000 ) : 0;
         }
-
-        xTaskNotifyWaitIndexed(NTFCN_IDX_LEDS, 0u, 0u, (uint32_t *) ( &leds ), 0u);
-
-        ASSERT_IS_A(c, CONTEXT_T);
-
-        if ( !( c->display_ccb.callback ) ) {
+        uint32_t posted = 0u;
+        bool event = xTaskNotifyWaitIndexed(NTFCN_IDX_EVENT, 0u, 0xFFFFFFFFu, &posted, wait);
+        if ( !event && wait == portMAX_DELAY ) {
             continue;
         }
-        bitmap_clear(c->pane);
-        c->display_ccb.callback(c, c->display_ccb.data, (v32_t) 0ul);
 
-        if (leds) {
-            ws2812_put_pixels(leds->rgb_p, 3);
-            ws2813b_sparkle_pixels(leds->rgb_p, 3);
+        /*  Frame pacing:  hold off until this frame's slot comes up, then render
+         *  whatever was posted last.  Everything posted in between is coalesced.  */
+        int32_t early_us = next_frame_us - time_us_32();
+        if (early_us > 0) {
+            uint32_t more = 0u;
+            vTaskDelay( pdMS_TO_TICKS( ( early_us + 999 ) / 1000 ) );
+            event |= xTaskNotifyWaitIndexed(NTFCN_IDX_EVENT, 0u, 0xFFFFFFFFu, &more, 0u);
+            posted |= more;
         }
-
-        /* If an assert fails in the xSemaphoreTake, it likely means the ContextScreen is corrupt */
-        bitmap_clear(screen_buffer);
-
-        bitmap_copy_from_bound(screen_buffer, c->pane, 0, 0, c->pane->width,
-                c->use_labels ? RE_LABEL_Y_OFFSET : c->pane->height
-                );
-        if (c->use_labels) {
-            bitmap_draw_string(screen_buffer, 0, RE_LABEL_Y_OFFSET,
-                    &TRIPLE_LINE_TEXT_FONT, c->re_labels[re_offsets[0]]
-                    );
-            bitmap_draw_string(screen_buffer,
-                    ( RE_LABEL_TOTAL_WIDTH - TRIPLE_LINE_TEXT_FONT.Width *
-                      strnlen(c->re_labels[re_offsets[2]],
-                              8
-                              ) ) / 2,
-                    RE_LABEL_Y_OFFSET,
-                    &TRIPLE_LINE_TEXT_FONT,
-                    c->re_labels[re_offsets[1]]
-                    );
-            bitmap_draw_string(screen_buffer,
-                    RE_LABEL_TOTAL_WIDTH - TRIPLE_LINE_TEXT_FONT.Width *
-                    strnlen(c->re_labels[re_offsets[2]],8),
-                    RE_LABEL_Y_OFFSET, &TRIPLE_LINE_TEXT_FONT, c->re_labels[re_offsets[2]]
-                    );
+        uint32_t frame_start_us = time_us_32();
+
+        if (event) {
+            uint32_t invalidations = display_stats.invalidations;
+            if (invalidations - rendered_invalidations > 1) {
+                display_stats.invalidations_coalesced +=
+                    invalidations - rendered_invalidations - 1;
+            }
+            rendered_invalidations = invalidations;
         }
 
-        /*
-         * Draw the chevrons if they're there
-         */
-        bitmap_draw_char(screen_buffer, RE_LABEL_TOTAL_WIDTH, 0,
-                &BUTTON_LABEL_FONT, c->button_chars[0]
-                );
-        bitmap_draw_char(screen_buffer, RE_LABEL_TOTAL_WIDTH,
-                BUTTON_LABEL_FONT.Height, &BUTTON_LABEL_FONT, c->button_chars[1]
+        /*  Only panels that were posted to, or are animating, are rendered;
+         *  each one sends only its own changes.  */
+        bool animating = animation_running_p(frame_start_us);
+        uint32_t render_us = 0;
+        latency_frame_begin(LATENCY_OUTPUT_DISPLAY);
+        for (uint8_t i = 0; i < SCREEN_COUNT; i++) {
+            panel_t *p = &panels[i];
+            if ( posted & ( 1u << i ) ) {
+                taskENTER_CRITICAL();
+                p->context = panel_posts[i];
+                taskEXIT_CRITICAL();
+                p->dirty = true;
+            }
+            if ( !p->context || !( p->dirty || animating ) ) {
+                continue;
+            }
+            ASSERT_IS_A(p->context, CONTEXT_T);
+            if ( !( p->context->display_ccb.callback ) ) {
+                continue;
+            }
+            render_us += s_panel_render( p, time_us_32() );
+        }
+        uint32_t frame_end_us = time_us_32();
+        latency_frame_end(LATENCY_OUTPUT_DISPLAY);
+
+        display_stats.frames++;
+        display_stats.render_us = render_us;
+        display_stats.render_us_max = MAX(display_stats.render_us_max, display_stats.render_us);
+        display_stats.transfer_us = frame_end_us - frame_start_us - render_us;
+        display_stats.transfer_us_max = MAX(display_stats.transfer_us_max,
+                display_stats.transfer_us
                 );
 
-        ssd1306_show( (ssd1306_t *) screen_buffer->buffer );
+        /*  Budget check:  a frame that overran its slot skips the slots it missed
+         *  rather than rendering them late.  Tweens are time-based, so only
+         *  smoothness is lost, and the input tasks are never held up.  */
+        uint32_t missed = ( frame_end_us - frame_start_us ) / FRAME_PERIOD_US;
+        display_stats.frames_dropped += missed;
+        next_frame_us = frame_start_us + ( missed + 1 ) * FRAME_PERIOD_US;
     }
 } /* context_display_task */
 
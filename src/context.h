@@ -64,15 +64,33 @@ typedef struct {
     void *data;
 } context_callback_t;
 
+/** @brief A colour the LEDs can follow.  The version changes with every
+ *         write, so an observer only has to compare versions to know what
+ *         it has already sent.
+ */
+typedef struct led_color {
+    volatile uint32_t rgb;
+    volatile uint32_t version;
+} led_color_t;
+
+static inline void led_color_set(led_color_t *c, uint32_t rgb)
+{
+    if (c->rgb != rgb) {
+        c->rgb = rgb;
+        c->version++;
+    }
+}
+
 /** @brief Hold the current configuration of the three WS2812 RGBs on the board.
  *
- *  Note that we use pointers so that if a different portion of the program
- *  changes the actual value, the display will automatically update.  Think of
- *  this as a quick and dirty "observer" pattern.
+ *  The LEDs subscribe to the colours bound here and follow their versions.
+ *  Rebinding bumps the version of the set as a whole.
  */
 typedef struct context_leds {
     uint32_t magic_number;
-    uint32_t *rgb_p[WS2812_PIXEL_COUNT];
+    const led_color_t *colors[WS2812_PIXEL_COUNT];
+    int8_t notes[WS2812_PIXEL_COUNT];  /**< Note behind each colour, C is 0 */
+    volatile uint32_t version;         /**< Changes whenever the bindings do */
 } context_leds_t;
 
 #define CTX_MSG_TYP_LINE1_CB 0x01
@@ -82,28 +100,53 @@ typedef struct context_config_msg {
     void *msg_data;
 } context_config_msg_t;
 
+/** @brief Buttons that act together when all of them, and no others, are down */
+typedef struct context_combo {
+    uint32_t buttons;  /**< Bit per button offset */
+    context_callback_t ccb;
+} context_combo_t;
+
 #define RE_LABEL_LEN 8
+#define CONTEXT_COMBOS 4
 struct context {
     pcp_t pcp;
     QueueHandle_t config_q;
     bitmap_t *pane;
 
-    context_callback_t re_ccb[IO_PIO_SLOTS/2];
-    char re_labels[IO_PIO_SLOTS/2][RE_LABEL_LEN + 1];
+    context_callback_t re_ccb[RE_COUNT];
+    bool re_accelerated; /**< Fast spins reach re_ccb as larger deltas */
+    char re_labels[RE_COUNT][RE_LABEL_LEN + 1];
     bool use_labels;
-    context_callback_t button_ccb[IO_PIO_SLOTS];
-    uint16_t button_chars[IO_PIO_SLOTS];
+    context_callback_t button_ccb[BUTTON_COUNT];
+    uint16_t button_chars[BUTTON_COUNT];
+    context_callback_t gesture_ccb[BUTTON_COUNT]; /**< See gesture.h */
+    context_combo_t combos[CONTEXT_COMBOS];
 
     context_callback_t enable_ccb;
     context_callback_t display_ccb;
 
+    uint8_t panel;       /**< Logical panel the context is shown on */
+    int8_t scroll_pages; /**< Hardware scroll requested for the next render */
+
     void *data;
 };
 
+/** @brief Per-frame timing and scheduling counters of the display task */
+typedef struct display_stats {
+    uint32_t frames;          /**< Frames rendered and sent to the panel */
+    uint32_t frames_dropped;  /**< Frame slots skipped because a frame overran */
+    uint32_t invalidations;   /**< Calls to context_notify_display_task() */
+    uint32_t invalidations_coalesced; /**< Invalidations folded into another's frame */
+    uint32_t render_us;       /**< Render time of the last frame */
+    uint32_t render_us_max;
+    uint32_t transfer_us;     /**< Panel transfer time of the last frame */
+    uint32_t transfer_us_max;
+} display_stats_t;
+
 typedef struct task_list {
-    TaskHandle_t rotary_encoders;
-    TaskHandle_t buttons;
+    TaskHandle_t input;
     TaskHandle_t display;
+    TaskHandle_t leds;
 } task_list_t;
 
 extern task_list_t tasks;
@@ -111,6 +154,7 @@ extern task_list_t tasks;
 /* ---------------------------------------------------------------------- */
 
 void context_display_task(void *parm);
+const display_stats_t *context_display_stats();
 
 void context_push(context_t *c, void *f);
 context_t *context_current();
@@ -118,11 +162,17 @@ void *context_frame_data();
 context_t *context_pop();
 uint32_t context_stack_depth();
 
-static inline void context_notify_display_task(context_t *c)
+void context_notify_display_task(context_t *c);
+
+/** @brief Ask the display task to hardware-scroll the screen before the next
+ *         render of this context.  The render must leave the scrolled pages
+ *         where the scroll put them, otherwise the hint only costs a resend.
+ */
+static inline void context_request_scroll(context_t *c, int8_t pages)
 {
-    xTaskNotifyIndexed(tasks.display, NTFCN_IDX_EVENT, (uint32_t) c,
-            eSetValueWithOverwrite
-            );
+    taskENTER_CRITICAL();
+    c->scroll_pages += pages;
+    taskEXIT_CRITICAL();
 }
 
 void context_set_button_char(context_t *c, uint8_t offset, int16_t v);
@@ -134,6 +184,7 @@ static inline void context_set_lower_button_char(context_t *c, int16_t v)
 {
     context_set_button_char(c, BUTTON_LOWER_OFFSET, v);
 }
+void context_set_re_label(context_t *c, uint8_t re_offset, const char *label);
 
 bitmap_t *context_get_drawing_pane(context_t *);
 context_callback_t *context_get_button_callback(context_t *, uint8_t);
@@ -171,6 +222,7 @@ static inline void context_builder_set_blue_re(
             );
 }
 void context_builder_set_re_label(uint8_t re_offset, const char *label);
+void context_builder_set_re_acceleration(bool accelerated);
 
 void context_builder_set_button(uint8_t offset, context_callback_f callback,
         void *data, int16_t label);
@@ -184,12 +236,17 @@ static inline void context_builder_set_lower_button(context_callback_f callback,
 {
     context_builder_set_button(BUTTON_LOWER_OFFSET, callback, data, label);
 }
+void context_builder_set_gesture(uint8_t offset, context_callback_f callback,
+        void *data);
+void context_builder_add_combo(uint32_t buttons, context_callback_f callback,
+        void *data);
 
 void context_builder_set_display_callback(context_callback_f callback,
         void *data);
 void context_builder_set_enable_callback(context_callback_f callback,
         void *data);
 
+void context_builder_set_panel(uint8_t panel);
 void context_builder_set_data(void *data);
 
 context_t *context_builder_finalize();
@@ -0,0 +1,201 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** @file gesture.c
+ *
+ */
+
+#include "pico/stdlib.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+#include "button.h"
+#include "context.h"
+#include "gesture.h"
+#include "gesture_wheel.h"
+#include "log.h"
+
+/*  The wheel turns once per GESTURE_TICK_MS while any deadline is armed  */
+#define GESTURE_TICKS( ms )   ( ( ( ms ) + GESTURE_TICK_MS - 1 ) / GESTURE_TICK_MS )
+
+static_assert(BUTTON_COUNT <= GESTURE_WHEEL_BUTTONS, "Gestures keep one bit per button");
+static_assert(GESTURE_TICKS(GESTURE_LONG_PRESS_MS) < GESTURE_WHEEL_SLOTS &&
+        GESTURE_TICKS(GESTURE_DOUBLE_CLICK_MS) < GESTURE_WHEEL_SLOTS,
+        "Gesture deadlines must be shorter than a turn of the wheel");
+
+typedef enum {
+    GESTURE_IDLE,
+    GESTURE_DOWN,       /* Pressed, the long press is armed */
+    GESTURE_UP,         /* Released, waiting out the double-click window */
+    GESTURE_DOWN_AGAIN, /* Second press of a double click */
+    GESTURE_SPENT,      /* Reported while held; nothing more until release */
+} gesture_state_t;
+
+typedef struct {
+    context_t *context; /* A gesture belongs to the context it started in */
+    uint32_t down_us;
+    uint32_t held_us;   /* First press of a possible double click */
+    uint8_t state;
+} gesture_button_t;
+
+static gesture_button_t gesture_buttons[BUTTON_COUNT];
+static gesture_wheel_t wheel;
+static volatile uint32_t ticks; /* Counted by the timer */
+static TimerHandle_t timer;
+static bool timer_running;
+
+/* ---------------------------------------------------------------------- */
+
+/*  Runs on the timer task, so it only counts and wakes the input task  */
+static void s_gesture_timer(TimerHandle_t t)
+{
+    ticks++;
+    xTaskNotifyGiveIndexed(tasks.input, NTFCN_IDX_EVENT);
+}
+
+static void s_gesture_arm(uint8_t b, uint32_t ms)
+{
+    if (!timer_running) {
+        xTimerStart(timer, 0);
+        timer_running = true;
+    }
+    gesture_wheel_arm(&wheel, b, ticks, GESTURE_TICKS(ms));
+}
+
+static void s_gesture_fire(context_t *context, uint8_t b, gesture_t g, uint32_t us)
+{
+    if (gesture_buttons[b].context != context) {
+        return; /* The context has moved on */
+    }
+    context_callback_t *c = &context->gesture_ccb[b];
+    if (c->callback) {
+        log_trace("Button %d gesture %d (%lu us)", b, g, us);
+        c->callback(context, c->data, GESTURE_VALUE(g, us / 1000));
+    }
+}
+
+static bool s_gesture_combo(context_t *context, const input_event_t *e)
+{
+    for (uint8_t i = 0; i < CONTEXT_COMBOS; i++) {
+        context_combo_t *k = &context->combos[i];
+        if (!k->buttons || k->buttons != buttons_depressed) {
+            continue;
+        }
+
+        /*  The combo spends its buttons, so none of them also clicks  */
+        uint32_t first_us = e->time_us;
+        for (uint32_t m = k->buttons; m; m &= m - 1) {
+            gesture_button_t *gb = &gesture_buttons[__builtin_ctz(m)];
+            if (gb->state != GESTURE_IDLE && (int32_t) ( gb->down_us - first_us ) < 0) {
+                first_us = gb->down_us;
+            }
+            gb->state = GESTURE_SPENT;
+        }
+        gesture_wheel_cancel(&wheel, k->buttons);
+        if (k->ccb.callback) {
+            k->ccb.callback(context, k->ccb.data,
+                    GESTURE_VALUE(GESTURE_COMBO, ( e->time_us - first_us ) / 1000)
+                    );
+        }
+        return true;
+    }
+    return false;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void gesture_init()
+{
+    timer = xTimerCreate("Gestures", pdMS_TO_TICKS(GESTURE_TICK_MS), pdTRUE, NULL,
+            s_gesture_timer
+            );
+}
+
+/** @brief Follow one button edge.  Call after buttons_depressed is updated. */
+void gesture_button(context_t *context, const input_event_t *e)
+{
+    uint8_t b = e->device;
+    gesture_button_t *gb = &gesture_buttons[b];
+
+    if (e->value) {
+        if ( s_gesture_combo(context, e) ) {
+            return;
+        }
+        if (gb->state == GESTURE_UP && gb->context == context) {
+            gb->state = GESTURE_DOWN_AGAIN;
+            gesture_wheel_cancel(&wheel, 1u << b);
+        } else {
+            gb->context = context;
+            gb->state = GESTURE_DOWN;
+            s_gesture_arm(b, GESTURE_LONG_PRESS_MS);
+        }
+        gb->down_us = e->time_us;
+        return;
+    }
+
+    uint32_t held = e->time_us - gb->down_us;
+    switch (gb->state) {
+    case GESTURE_DOWN:
+        gb->state = GESTURE_UP;
+        gb->held_us = held;
+        s_gesture_arm(b, GESTURE_DOUBLE_CLICK_MS);
+        break;
+    case GESTURE_DOWN_AGAIN:
+        gb->state = GESTURE_IDLE;
+        s_gesture_fire(context, b, GESTURE_DOUBLE_CLICK, held);
+        break;
+    default:
+        gb->state = GESTURE_IDLE;
+        break;
+    }
+} /* gesture_button */
+
+/** @brief Fire the deadlines the wheel has turned past. */
+void gesture_advance(context_t *context)
+{
+    uint32_t now = ticks;
+
+    while ( gesture_wheel_due(&wheel, now) ) {
+        for (uint32_t due = gesture_wheel_turn(&wheel); due; due &= due - 1) {
+            uint8_t b = __builtin_ctz(due);
+            gesture_button_t *gb = &gesture_buttons[b];
+            if (gb->state == GESTURE_DOWN) {
+                gb->state = GESTURE_SPENT;
+                s_gesture_fire(context, b, GESTURE_LONG_PRESS, time_us_32() - gb->down_us);
+            } else if (gb->state == GESTURE_UP) {
+                gb->state = GESTURE_IDLE;
+                s_gesture_fire(context, b, GESTURE_CLICK, gb->held_us);
+            }
+        }
+    }
+
+    if (!wheel.armed && timer_running) {
+        xTimerStop(timer, 0);
+        timer_running = false;
+    }
+} /* gesture_advance */
+
+/** @brief True when the wheel has turned since the last gesture_advance() */
+bool gesture_due()
+{
+    return gesture_wheel_due(&wheel, ticks);
+}
@@ -0,0 +1,74 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GESTURE_H
+#define __GESTURE_H
+
+#include "pico/stdlib.h"
+
+#include "context.h"
+#include "input.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @file gesture.h
+ *
+ *  @brief Clicks, double clicks, long presses and button combos, recognised
+ *         from the button event stream.
+ *
+ *  Raw presses and releases still go to the button callbacks as they happen.
+ *  Gestures go to the context's gesture callbacks, with the gesture and its
+ *  duration packed in the value.  Every pending deadline of every button
+ *  sits on one timer wheel driven by one FreeRTOS timer, so arming, cancelling
+ *  and firing a deadline are constant time however many buttons there are.
+ */
+
+typedef enum gesture {
+    GESTURE_CLICK = 1,    /**< Pressed and released, with no second press */
+    GESTURE_DOUBLE_CLICK, /**< A second press soon after a click */
+    GESTURE_LONG_PRESS,   /**< Held past GESTURE_LONG_PRESS_MS; fires while held */
+    GESTURE_COMBO,        /**< Every button of a registered combo down together */
+} gesture_t;
+
+#define GESTURE_VALUE( g, ms ) ( (v32_t) (uint32_t) ( ( ms ) << 8 | ( g ) ) )
+
+static inline gesture_t gesture_type(v32_t v)
+{
+    return (gesture_t) ( v.u & 0xffu );
+}
+
+/** @brief How long the (last) press lasted, or has lasted so far, in ms */
+static inline uint32_t gesture_duration_ms(v32_t v)
+{
+    return v.u >> 8;
+}
+
+void gesture_init();
+void gesture_button(context_t *context, const input_event_t *e);
+void gesture_advance(context_t *context);
+bool gesture_due();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __GESTURE_H */
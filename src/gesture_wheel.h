@@ -0,0 +1,98 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GESTURE_WHEEL_H
+#define __GESTURE_WHEEL_H
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @file gesture_wheel.h
+ *
+ *  @brief The gesture deadlines on their own, free of the SDK and FreeRTOS so
+ *         the host tests can turn the wheel by hand.
+ *
+ *  A deadline sits in the slot of its tick as one bit per button; it must be
+ *  less than a lap away.  Arming a button again leaves its old bit behind,
+ *  which no longer matches the button's deadline when the wheel reaches it.
+ */
+
+#define GESTURE_WHEEL_SLOTS   128
+#define GESTURE_WHEEL_BUTTONS 32
+static_assert((GESTURE_WHEEL_SLOTS & (GESTURE_WHEEL_SLOTS - 1)) == 0,
+        "GESTURE_WHEEL_SLOTS must be a power of two");
+
+typedef struct gesture_wheel {
+    uint32_t slots[GESTURE_WHEEL_SLOTS];
+    uint32_t deadline[GESTURE_WHEEL_BUTTONS];  /**< Tick of each live deadline */
+    uint32_t armed;                            /**< Buttons with a live deadline */
+    uint32_t processed;                        /**< Last tick turned past */
+} gesture_wheel_t;
+
+/** @brief Give button b a deadline ticks after now, replacing any it had */
+static inline void gesture_wheel_arm(gesture_wheel_t *w, uint8_t b, uint32_t now, uint32_t ticks)
+{
+    if (!w->armed) {
+        w->processed = now;
+    }
+    w->deadline[b] = now + ticks;
+    w->slots[w->deadline[b] & ( GESTURE_WHEEL_SLOTS - 1 )] |= 1u << b;
+    w->armed |= 1u << b;
+}
+
+static inline void gesture_wheel_cancel(gesture_wheel_t *w, uint32_t buttons)
+{
+    w->armed &= ~buttons;
+}
+
+/** @brief True while the wheel is behind now with a deadline armed */
+static inline bool gesture_wheel_due(const gesture_wheel_t *w, uint32_t now)
+{
+    return w->armed && w->processed != now;
+}
+
+/** @brief Turn one tick:  the buttons whose deadline it was, now disarmed */
+static inline uint32_t gesture_wheel_turn(gesture_wheel_t *w)
+{
+    w->processed++;
+    uint32_t *slot = &w->slots[w->processed & ( GESTURE_WHEEL_SLOTS - 1 )];
+    uint32_t due = *slot & w->armed;
+    *slot = 0;
+
+    for (uint32_t m = due; m; m &= m - 1) {
+        uint8_t b = __builtin_ctz(m);
+        if (w->deadline[b] != w->processed) {
+            due &= ~( 1u << b );
+        }
+    }
+    w->armed &= ~due;
+    return due;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __GESTURE_WHEEL_H */
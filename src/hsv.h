@@ -0,0 +1,97 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HSV_H
+#define __HSV_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @file hsv.h
+ *
+ *  @brief HSV, all integer.  Hue is six sectors of 256 steps; within a sector
+ *         each channel is one of v, p, q or t, and which is which comes from
+ *         a table.  Nothing here needs the SDK, so the host tests build it.
+ */
+
+#define HUE_SECTOR 256
+#define HUE_RANGE ( 6 * HUE_SECTOR )
+
+enum { HSV_V, HSV_P, HSV_Q, HSV_T };
+
+static const uint8_t hsv_sectors[6][3] = {
+    { HSV_V, HSV_T, HSV_P }, { HSV_Q, HSV_V, HSV_P }, { HSV_P, HSV_V, HSV_T },
+    { HSV_P, HSV_Q, HSV_V }, { HSV_T, HSV_P, HSV_V }, { HSV_V, HSV_P, HSV_Q },
+};
+
+/** @brief a * b / 255, rounded, without a divide */
+static inline uint8_t hsv_mul255(uint8_t a, uint8_t b)
+{
+    uint32_t t = a * b + 128u;
+    return ( t + ( t >> 8 ) ) >> 8;
+}
+
+static inline uint32_t hsv_to_rgb(uint16_t h, uint8_t s, uint8_t v)
+{
+    uint8_t f = h & ( HUE_SECTOR - 1 );
+    const uint8_t *sector = hsv_sectors[h / HUE_SECTOR];
+    uint8_t k[4];
+
+    k[HSV_V] = v;
+    k[HSV_P] = hsv_mul255(v, 255 - s);
+    k[HSV_Q] = hsv_mul255(v, 255 - hsv_mul255(s, f));
+    k[HSV_T] = hsv_mul255(v, 255 - hsv_mul255(s, 255 - f));
+    return ( (uint32_t) k[sector[0]] << 16 ) | ( k[sector[1]] << 8 ) | k[sector[2]];
+}
+
+/** @brief Greys have no hue, so *h is left as it was for them */
+static inline void hsv_from_rgb(uint32_t rgb, uint16_t *h, uint8_t *s, uint8_t *v)
+{
+    int32_t r = ( rgb >> 16 ) & 0xFF, g = ( rgb >> 8 ) & 0xFF, b = rgb & 0xFF;
+    int32_t max = r > g ? ( r > b ? r : b ) : ( g > b ? g : b );
+    int32_t min = r < g ? ( r < b ? r : b ) : ( g < b ? g : b );
+    int32_t delta = max - min;
+
+    *v = max;
+    if (delta == 0) {
+        *s = 0;
+        return;
+    }
+    *s = ( delta * 255 + max / 2 ) / max;
+
+    int32_t hue;
+    if (max == r) {
+        hue = ( g - b ) * HUE_SECTOR / delta;
+    } else if (max == g) {
+        hue = 2 * HUE_SECTOR + ( b - r ) * HUE_SECTOR / delta;
+    } else {
+        hue = 4 * HUE_SECTOR + ( r - g ) * HUE_SECTOR / delta;
+    }
+    *h = ( hue + HUE_RANGE ) % HUE_RANGE;
+} /* hsv_from_rgb */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HSV_H */
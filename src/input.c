@@ -51,10 +51,15 @@
 #include "pico/stdlib.h"
 
 #include "hardware/pio.h"
+#include "hardware/dma.h"
 
+#include "button.h"
 #include "context.h"
+#include "gesture.h"
 #include "input.h"
+#include "input_record.h"
 #include "log.h"
+#include "rotary_encoder.h"
 
 #include "io_devices.pio.h"
 
@@ -63,22 +68,39 @@
 
 static irq_interrupt_handler_type _interrupt_handler[NUM_PIOS][NUM_PIO_STATE_MACHINES];
 static void *_interrupt_arg[NUM_PIOS][NUM_PIO_STATE_MACHINES];
+static uint32_t _interrupt_count[NUM_PIOS][NUM_PIO_STATE_MACHINES];
+
+input_ring_t input_events;
 
 static uint8_t io_devices_8_offset = 32;
+#ifdef INPUT_SHIFT_REGISTERS
+static uint8_t io_shift_165_offset = 32;
+#endif
 
-static uint8_t program_offset() {
-  if (io_devices_8_offset < 32) return io_devices_8_offset;
-  return (io_devices_8_offset = pio_add_program(PIOx, &io_devices_8_program));
+static uint8_t program_offset(const pio_program_t *program, uint8_t *offset) {
+  if (*offset < 32) return *offset;
+  return (*offset = pio_add_program(PIOx, program));
 }
 
+/* Shared by every PIO's IRQ 0, so any state machine of any PIO can have a handler */
 __isr static void pio_irq_interrupt_handler(void) {
-    uint8_t i = 1;
-    PIO pio = PIOx;
+  for (uint8_t i = 0; i < NUM_PIOS; i++) {
+    PIO pio = pio_get_instance(i);
+    uint32_t ints = pio->ints0;
+    if (!ints) continue;
     for (uint8_t sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
       if (!_interrupt_handler[i][sm]) continue;
       uint32_t intf = (PIO_INTR_SM0_RXNEMPTY_BITS|PIO_INTR_SM0_TXNFULL_BITS|PIO_INTR_SM0_BITS)<<sm;
-      if (pio->ints0 & intf) _interrupt_handler[i][sm](pio, sm, _interrupt_arg[i][sm]);
+      if (ints & intf) {
+        _interrupt_count[i][sm]++;
+        _interrupt_handler[i][sm](pio, sm, _interrupt_arg[i][sm]);
+      }
     }
+  }
+}
+
+uint32_t input_irq_count(PIO pio, uint8_t sm) {
+  return _interrupt_count[pio_get_index(pio)][sm];
 }
 
 void input_pio_irq_set_handler(PIO pio, uint8_t sm, irq_interrupt_handler_type handler, TaskHandle_t arg, int mask) {
@@ -97,17 +119,173 @@ void input_pio_irq_set_handler(PIO pio, uint8_t sm, irq_interrupt_handler_type h
   irq_set_enabled(PIO0_IRQ_0 + i*2, true);
 }
 
-void input_init_sm(uint8_t low_pin, uint8_t sm) {
+#ifdef INPUT_DMA
+typedef struct {
+  int dma_channel;
+  input_decode_f decode;  /* NULL until the SM is captured */
+  uint32_t read;     /* Words decoded so far */
+  uint32_t read_us;  /* When they were */
+  uint32_t overruns;
+} input_dma_t;
+
+static input_dma_t _dma[NUM_PIO_STATE_MACHINES];
+static uint32_t _dma_ring[NUM_PIO_STATE_MACHINES][INPUT_DMA_RING_WORDS]
+    __attribute__((aligned(INPUT_DMA_RING_WORDS * 4)));
+
+/* The channel counts down from ~0, so the words written are the count's complement */
+static inline uint32_t s_dma_written(const input_dma_t *d) {
+  return ~dma_channel_hw_addr(d->dma_channel)->transfer_count;
+}
+
+void input_dma_capture(PIO pio, uint8_t sm, input_decode_f decode) {
+  input_dma_t *d = &_dma[sm];
+  d->decode = decode;
+  d->dma_channel = dma_claim_unused_channel(true);
+  d->read = 0;
+  d->read_us = time_us_32();
+
+  dma_channel_config c = dma_channel_get_default_config(d->dma_channel);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, true);
+  channel_config_set_ring(&c, true, __builtin_ctz(INPUT_DMA_RING_WORDS * 4));
+  channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));
+  /* 2^32 words is years of turning, so the channel is never re-armed */
+  dma_channel_configure(d->dma_channel, &c, _dma_ring[sm], &pio->rxf[sm], 0xffffffffu, true);
+}
+
+/*
+ *  The capture carries no times, so the words found by a drain are spread
+ *  evenly over the time since the previous one.  That keeps the spacing of
+ *  detents meaningful to anything timing them.
+ */
+static uint32_t s_dma_drain(uint8_t sm) {
+  input_dma_t *d = &_dma[sm];
+  uint32_t now = time_us_32();
+  uint32_t written = s_dma_written(d);
+  uint32_t n = written - d->read;
+
+  if (n > INPUT_DMA_RING_WORDS) {
+    d->overruns += n - INPUT_DMA_RING_WORDS;
+    d->read = written - INPUT_DMA_RING_WORDS;
+    n = INPUT_DMA_RING_WORDS;
+  }
+
+  uint32_t span = now - d->read_us;
+  for (uint32_t k = 0; k < n; k++) {
+    d->decode(_dma_ring[sm][(d->read + k) & (INPUT_DMA_RING_WORDS - 1)],
+        d->read_us + span * (k + 1) / n);
+  }
+  d->read += n;
+  d->read_us = now;
+  return n;
+}
+
+/* Each SM in turn, so events only keep their order within an SM and a poll */
+uint32_t input_dma_drain() {
+  uint32_t n = 0;
+  for (uint8_t sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+    if (_dma[sm].decode) n += s_dma_drain(sm);
+  }
+  return n;
+}
+
+input_dma_stats_t input_dma_stats(uint8_t sm) {
+  input_dma_t *d = &_dma[sm];
+  return (input_dma_stats_t) {
+    .ring = _dma_ring[sm],
+    .written = s_dma_written(d),
+    .read = d->read,
+    .overruns = d->overruns,
+  };
+}
+#endif
+
+void input_init_sm(uint8_t low_pin, uint8_t sm, uint8_t stable_samples) {
+  assert(stable_samples >= 1 && stable_samples <= 32);
   pio_sm_claim(PIOx, sm);
-  io_devices_8_program_init(PIOx, sm, program_offset(), low_pin);
+  io_devices_8_program_init(PIOx, sm, program_offset(&io_devices_8_program, &io_devices_8_offset),
+      low_pin, stable_samples);
 
   pio_sm_exec(PIOx, sm, 0xe040);  /* set y, 0 */
   pio_sm_exec(PIOx, sm, 0xa04a);  /* mov y, !y - make y 0xffff - guarantee a PUSH */
   pio_sm_set_enabled(PIOx, sm, true);
 }
 
+#ifdef INPUT_SHIFT_REGISTERS
+/*
+ *  A chain of 74HC165s: PL on load_pin, CLK on the pin after it, and the last
+ *  register's Q7 on data_pin.  The SM pushes the chain's bits only when they
+ *  change, the input nearest Q7 in the highest bit.
+ */
+void input_init_shift_sm(uint8_t load_pin, uint8_t data_pin, uint8_t sm, uint8_t bits) {
+  assert(bits >= 1 && bits <= 32);
+  input_init_pin(data_pin);
+  pio_sm_claim(PIOx, sm);
+  io_shift_165_program_init(PIOx, sm, program_offset(&io_shift_165_program, &io_shift_165_offset),
+      load_pin, data_pin, bits, INPUT_SR_CLOCK_HZ);
+
+  pio_sm_exec(PIOx, sm, 0xe040);  /* set y, 0 */
+  pio_sm_exec(PIOx, sm, 0xa04a);  /* mov y, !y - make y 0xffff - guarantee a PUSH */
+  pio_sm_set_enabled(PIOx, sm, true);
+}
+#endif
+
 void input_init_pin(uint8_t pin) {
       gpio_set_function(pin, GPIO_FUNC_PIOx);
       gpio_set_input_enabled(pin, true);
       gpio_pull_up(pin);
 }
+
+/*
+ *  The one task behind the encoders and buttons.  Events are handled in the
+ *  order they happened, each against the context current when it is handled:
+ *  a callback that switches contexts is seen before the next event.
+ */
+void input_task(void *parm) {
+  context_t *context = NULL;
+
+  gesture_init();
+  rotary_encoder_init(RE_LOW_PIN, RE_SM);
+  button_init(BUTTON_LOW_PIN, BUTTON_SM);
+
+  for( ;; ) {
+    /* Update the context if necessary */
+    do {
+      xTaskNotifyWaitIndexed(NTFCN_IDX_CONTEXT, 0u, 0u, (uint32_t *)(&context), context? 0 : portMAX_DELAY);
+    } while(!context);
+
+    log_trace("Processing input");
+    input_event_t e;
+    for (;;) {
+      if (input_ring_pop(&input_events, &e)) {
+        input_record_event(&e);
+      } else if (!input_replay_next(&e)) {
+        break;
+      }
+      ASSERT_IS_A(context, CONTEXT_T);
+      if (e.source == INPUT_ENCODER) {
+        rotary_encoder_event(context, &e);
+      } else {
+        button_event(context, &e);
+      }
+      xTaskNotifyWaitIndexed(NTFCN_IDX_CONTEXT, 0u, 0u, (uint32_t *)(&context), 0);
+    }
+    gesture_advance(context);
+
+    log_trace("Input->UI Notification");
+    context_notify_display_task(context);
+
+#ifdef INPUT_DMA
+    /* Nothing interrupts; poll the capture until it holds an event */
+    do {
+      vTaskDelay(pdMS_TO_TICKS(INPUT_DMA_POLL_MS));
+      input_dma_drain();
+    } while (input_ring_empty(&input_events) && !gesture_due() && input_replay_wait());
+#else
+    /* Spin-wait for the next event, a turn of the gesture wheel or a replayed event */
+    while (!ulTaskNotifyTakeIndexed(NTFCN_IDX_EVENT, pdTRUE, input_replay_wait())
+        && input_replay_wait());
+#endif
+  }
+}
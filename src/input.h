@@ -27,15 +27,96 @@
 #include "pico/stdlib.h"
 #include "hardware/pio.h"
 
+#include "input_ring.h"
+#include "pcp.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 typedef void (*irq_interrupt_handler_type)(PIO, uint8_t, TaskHandle_t);
 
+/* ---------------------------------------------------------------------- */
+
+/** @brief Wake the task draining a ring.  Call once per interrupt, after the
+ *         pushes, so the task wakes only once however many events arrived.
+ */
+static inline void input_ring_notify_from_isr(TaskHandle_t task)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    vTaskNotifyGiveIndexedFromISR(task, NTFCN_IDX_EVENT, &xHigherPriorityTaskWoken);
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+/** @brief Encoders and buttons share one ring, so the input task sees their
+ *         events in the order they happened.  Both producers run in the same
+ *         interrupt (or both in the input task), so there is still one producer.
+ */
+extern input_ring_t input_events;
+
+/* ---------------------------------------------------------------------- */
+
+void input_task(void *parm);
+
 void input_init_pin(uint8_t pin);
-void input_init_sm(uint8_t low_pin, uint8_t sm);
+void input_init_sm(uint8_t low_pin, uint8_t sm, uint8_t stable_samples);
+#ifdef INPUT_SHIFT_REGISTERS
+void input_init_shift_sm(uint8_t load_pin, uint8_t data_pin, uint8_t sm, uint8_t bits);
+#endif
 void input_pio_irq_set_handler(PIO pio, uint8_t sm, irq_interrupt_handler_type handler, TaskHandle_t arg, int mask);
+uint32_t input_irq_count(PIO pio, uint8_t sm);  /**< Interrupts taken for the SM */
+
+/** @brief Decode one word pushed by the input state machine, seen at time_us */
+typedef void (*input_decode_f)(uint32_t word, uint32_t time_us);
+
+/** @brief What a decoder remembers between words.  io_devices_8 pushes the
+ *         states before and after a change; a shift register chain pushes
+ *         only the state after, so the one before is kept here.  Pins idle
+ *         high, so both start from all ones.
+ */
+typedef struct input_scan {
+    uint32_t last;
+} input_scan_t;
+
+#define INPUT_SCAN_INIT { .last = 0xffffffffu }
+
+static inline void input_scan_word(input_scan_t *s, uint32_t word, uint32_t *prior,
+        uint32_t *now)
+{
+#ifdef INPUT_SHIFT_REGISTERS
+    *prior = s->last;
+    *now = word;
+    s->last = word;
+#else
+    *prior = word & 0xffu;
+    *now = ( word >> 8 ) & 0xffu;
+#endif
+}
+
+#ifdef INPUT_DMA
+/*
+ *  Interrupt-free input: a DMA channel copies every word the state machine
+ *  pushes into a RAM ring, and the input task decodes whatever accumulated
+ *  each time it polls.
+ */
+#ifndef INPUT_DMA_RING_WORDS
+#define INPUT_DMA_RING_WORDS 64
+#endif
+static_assert((INPUT_DMA_RING_WORDS & (INPUT_DMA_RING_WORDS - 1)) == 0 &&
+        INPUT_DMA_RING_WORDS * 4 <= 32768, "INPUT_DMA_RING_WORDS must be a power of two, 8192 at most");
+
+/** @brief Raw capture counters and history of one state machine */
+typedef struct input_dma_stats {
+    const uint32_t *ring;  /**< The last INPUT_DMA_RING_WORDS words pushed */
+    uint32_t written;      /**< Words captured; the newest is ring[(written-1) % size] */
+    uint32_t read;         /**< Words decoded */
+    uint32_t overruns;     /**< Words overwritten before they were decoded */
+} input_dma_stats_t;
+
+void input_dma_capture(PIO pio, uint8_t sm, input_decode_f decode);
+uint32_t input_dma_drain();
+input_dma_stats_t input_dma_stats(uint8_t sm);
+#endif
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,289 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** @file input_record.c
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "context.h"
+#include "input_record.h"
+#include "log.h"
+
+#ifdef INPUT_RECORD
+
+static_assert((INPUT_RECORD_EVENTS & (INPUT_RECORD_EVENTS - 1)) == 0,
+        "INPUT_RECORD_EVENTS must be a power of two");
+
+static input_record_t records[INPUT_RECORD_EVENTS];
+static uint32_t written;          /* Records ever written; the ring keeps the newest */
+static uint32_t last_us;
+static volatile bool recording;
+
+/*  Replay state, owned by the input task once started  */
+static volatile bool replaying;
+static uint32_t replay_next;      /* Index of the next record */
+static uint32_t replay_end;
+static uint32_t replay_due_us;
+static uint8_t replay_speed;
+
+/*  Load state, owned by whoever called input_load_start()  */
+static bool loading;
+static uint32_t load_count;       /* Records REC promised, once it has been seen */
+static bool load_counted;
+
+static inline uint32_t s_first()
+{
+    return written > INPUT_RECORD_EVENTS ? written - INPUT_RECORD_EVENTS : 0;
+}
+
+static inline input_record_t *s_record(uint32_t i)
+{
+    return &records[i & ( INPUT_RECORD_EVENTS - 1 )];
+}
+
+/* ---------------------------------------------------------------------- */
+
+void input_record_start()
+{
+    taskENTER_CRITICAL();
+    written = 0;
+    last_us = time_us_32();
+    recording = true;
+    taskEXIT_CRITICAL();
+}
+
+void input_record_stop()
+{
+    recording = false;
+}
+
+/** @brief Log one event.  Call on the input task, for real events only. */
+void input_record_event(const input_event_t *e)
+{
+    if (!recording) {
+        return;
+    }
+
+    /* A DMA capture can stamp an event from before the recording started */
+    int32_t since_us = e->time_us - last_us;
+    uint32_t ticks = MAX(since_us, 0) / INPUT_RECORD_US;
+    last_us += ticks * INPUT_RECORD_US;
+    while (ticks > UINT16_MAX) {
+        *s_record(written++) = (input_record_t) { UINT16_MAX, INPUT_RECORD_GAP, 0 };
+        ticks -= UINT16_MAX;
+    }
+    *s_record(written++) = (input_record_t) {
+        ticks,
+        e->device | ( e->source == INPUT_BUTTON ? INPUT_RECORD_BUTTON : 0 ),
+        e->value,
+    };
+}
+
+uint32_t input_record_count()
+{
+    return written - s_first();
+}
+
+/*
+ *  As hex, a record to a word, eight words to a line, between "REC <count>"
+ *  and "END" lines.
+ */
+void input_record_dump(FILE *f)
+{
+    uint32_t first = s_first();
+    fprintf(f, "REC %lu\n", (unsigned long) ( written - first ));
+    for (uint32_t i = first; i < written; i++) {
+        input_record_t *r = s_record(i);
+        fprintf(f, "%04x%02x%02x%c", r->delta, r->device, (uint8_t) r->value,
+                ( i - first ) % 8 == 7 || i + 1 == written ? '\n' : ' '
+                );
+    }
+    fprintf(f, "END\n");
+} /* input_record_dump */
+
+/* ---------------------------------------------------------------------- */
+
+/** @brief Get ready to read a dump back, line by line, over the recording */
+void input_load_start()
+{
+    taskENTER_CRITICAL();
+    recording = false;
+    replaying = false;
+    written = 0;
+    taskEXIT_CRITICAL();
+    loading = true;
+    load_counted = false;
+}
+
+void input_load_abort()
+{
+    written = 0;
+    loading = false;
+}
+
+static input_load_t s_load_fail(const char *why, const char *line)
+{
+    log_error("Load: %s at record %lu: %.16s", why, (unsigned long) written, line);
+    input_load_abort();
+    return INPUT_LOAD_ERROR;
+}
+
+/*
+ *  Lines ahead of REC are skipped, so whatever else was on the terminal can
+ *  come along with a paste.  Blank lines are skipped anywhere.
+ */
+input_load_t input_load_line(const char *line)
+{
+    const char *s = line + strspn(line, " \t\r\n");
+
+    if (!loading) {
+        return INPUT_LOAD_ERROR;
+    }
+    if (!load_counted) {
+        if (strncmp(s, "REC ", 4) != 0) {
+            return INPUT_LOAD_MORE;
+        }
+        char *end;
+        unsigned long count = strtoul(s + 4, &end, 10);
+        if (end == s + 4 || end[strspn(end, " \t\r\n")]) {
+            return s_load_fail("bad count", line);
+        }
+        if (count > INPUT_RECORD_EVENTS) {
+            return s_load_fail("more records than INPUT_RECORD_EVENTS", line);
+        }
+        load_count = count;
+        load_counted = true;
+        return INPUT_LOAD_MORE;
+    }
+
+    if (strncmp(s, "END", 3) == 0 && !s[3 + strspn(s + 3, " \t\r\n")]) {
+        if (written != load_count) {
+            return s_load_fail("short", line);
+        }
+        loading = false;
+        return INPUT_LOAD_DONE;
+    }
+
+    while (*s) {
+        size_t digits = strspn(s, "0123456789abcdefABCDEF");
+        if (digits != 8) {
+            return s_load_fail("bad record", s);
+        }
+        if (written == load_count) {
+            return s_load_fail("too many records", s);
+        }
+        uint32_t word = strtoul(s, NULL, 16);
+        *s_record(written++) = (input_record_t) {
+            word >> 16, ( word >> 8 ) & 0xffu, (int8_t) ( word & 0xffu ),
+        };
+        s += digits;
+        s += strspn(s, " \t\r\n");
+    }
+    return INPUT_LOAD_MORE;
+} /* input_load_line */
+
+/* ---------------------------------------------------------------------- */
+
+/** @brief Play the recording back, speed times faster than it was made */
+void input_replay_start(uint8_t speed)
+{
+    taskENTER_CRITICAL();
+    recording = false;
+    replay_next = s_first();
+    replay_end = written;
+    replay_speed = MAX(speed, 1);
+    replay_due_us = time_us_32();
+    replaying = replay_next != replay_end;
+    taskEXIT_CRITICAL();
+    if (tasks.input) {
+        xTaskNotifyGiveIndexed(tasks.input, NTFCN_IDX_EVENT);
+    }
+}
+
+void input_replay_stop()
+{
+    replaying = false;
+}
+
+/*
+ *  The next record's time is taken from the one before, so a late input task
+ *  delays the rest of the replay rather than bunching it up.
+ */
+static bool s_replay_due(uint32_t *wait_us)
+{
+    while (replaying) {
+        if (replay_next == replay_end) {
+            replaying = false;
+            log_info("%s", "Replay complete");
+            break;
+        }
+        input_record_t *r = s_record(replay_next);
+        uint32_t due_us = replay_due_us + r->delta * INPUT_RECORD_US / replay_speed;
+        int32_t until_us = due_us - time_us_32();
+        if (until_us > 0) {
+            *wait_us = until_us;
+            return false;
+        }
+        if (r->device != INPUT_RECORD_GAP) {
+            return true;
+        }
+        replay_due_us = due_us;
+        replay_next++;
+    }
+    *wait_us = UINT32_MAX;
+    return false;
+}
+
+/** @brief The next replayed event, if it is due.  Call on the input task. */
+bool input_replay_next(input_event_t *e)
+{
+    uint32_t wait_us;
+    if ( !s_replay_due(&wait_us) ) {
+        return false;
+    }
+    input_record_t *r = s_record(replay_next++);
+    replay_due_us += r->delta * INPUT_RECORD_US / replay_speed;
+    e->time_us = time_us_32();
+    e->source = r->device & INPUT_RECORD_BUTTON ? INPUT_BUTTON : INPUT_ENCODER;
+    e->device = r->device & ~INPUT_RECORD_BUTTON;
+    e->value = r->value;
+    return true;
+}
+
+/** @brief How long the input task may sleep before the next replayed event */
+TickType_t input_replay_wait()
+{
+    uint32_t wait_us;
+    if ( s_replay_due(&wait_us) ) {
+        return 0;
+    }
+    return wait_us == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS( ( wait_us + 999 ) / 1000 );
+}
+
+#endif /* INPUT_RECORD */
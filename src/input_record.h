@@ -0,0 +1,92 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INPUT_RECORD_H
+#define __INPUT_RECORD_H
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+
+#include "FreeRTOS.h"
+
+#include "input.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @file input_record.h
+ *
+ *  @brief Recording of the input events, and replay of a recording through
+ *         the input task as if the knobs were being turned again.
+ *
+ *  A record is four bytes: the time since the one before in 64us units, the
+ *  device (buttons with the top bit set) and the value.  Gaps too long for
+ *  one record are bridged by gap records.  The ring keeps the newest
+ *  INPUT_RECORD_EVENTS records.  Compiled in with INPUT_RECORD.
+ *
+ *  A dump is text, so it can be kept on the host and loaded back later: a
+ *  "REC <count>" line, the records as eight hex digits each, any number to a
+ *  line, then an "END" line.
+ */
+
+typedef struct input_record {
+    uint16_t delta;  /**< 64us units since the record before */
+    uint8_t device;  /**< INPUT_RECORD_BUTTON | offset, or INPUT_RECORD_GAP */
+    int8_t value;
+} input_record_t;
+
+#define INPUT_RECORD_US      64
+#define INPUT_RECORD_BUTTON  0x80u
+#define INPUT_RECORD_GAP     0x7fu
+
+typedef enum input_load {
+    INPUT_LOAD_MORE,   /**< Line taken, send the next */
+    INPUT_LOAD_DONE,   /**< END, after as many records as REC promised */
+    INPUT_LOAD_ERROR,  /**< A bad line or count;  the recording is left empty */
+} input_load_t;
+
+#ifdef INPUT_RECORD
+void input_record_start();
+void input_record_stop();
+void input_record_event(const input_event_t *e);
+uint32_t input_record_count();
+void input_record_dump(FILE *f);
+
+void input_load_start();
+input_load_t input_load_line(const char *line);
+void input_load_abort();
+
+void input_replay_start(uint8_t speed);
+void input_replay_stop();
+bool input_replay_next(input_event_t *e);
+TickType_t input_replay_wait();
+#else
+static inline void input_record_event(const input_event_t *e) { }
+static inline bool input_replay_next(input_event_t *e) { return false; }
+static inline TickType_t input_replay_wait() { return portMAX_DELAY; }
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INPUT_RECORD_H */
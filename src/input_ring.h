@@ -0,0 +1,117 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INPUT_RING_H
+#define __INPUT_RING_H
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @file input_ring.h
+ *
+ *  @brief The input event ring on its own.  Only the barrier comes from the
+ *         SDK, so the host tests build it with one of their own.
+ */
+
+#ifndef INPUT_RING_BARRIER
+#include "hardware/sync.h"
+#define INPUT_RING_BARRIER() __dmb()
+#endif
+
+typedef enum input_source {
+    INPUT_ENCODER,
+    INPUT_BUTTON,
+} input_source_t;
+
+/** @brief One detent or one button edge, as seen by the interrupt handler */
+typedef struct input_event {
+    uint32_t time_us;  /**< time_us_32() when the PIO reported it */
+    uint8_t source;    /**< An input_source_t */
+    uint8_t device;    /**< Offset of the encoder or button */
+    int8_t value;      /**< +1/-1 for a detent, 1 down/0 up for a button */
+} input_event_t;
+
+#ifndef INPUT_RING_SIZE
+#define INPUT_RING_SIZE 32
+#endif
+static_assert((INPUT_RING_SIZE & (INPUT_RING_SIZE - 1)) == 0,
+        "INPUT_RING_SIZE must be a power of two");
+
+/** @brief Lock-free ring from one interrupt handler to one task.
+ *
+ *  Only the handler moves head and only the task moves tail, so neither side
+ *  needs a lock.  The indices run free and are masked on use.  A full ring
+ *  drops the new event and counts it, the events already queued stay in
+ *  order.
+ */
+typedef struct input_ring {
+    input_event_t events[INPUT_RING_SIZE];
+    volatile uint32_t head;       /**< Next slot the producer fills */
+    volatile uint32_t tail;       /**< Next slot the consumer reads */
+    volatile uint32_t overflows;  /**< Events dropped on a full ring */
+    uint32_t high_water;          /**< Most events ever waiting at once */
+} input_ring_t;
+
+static inline bool input_ring_empty(const input_ring_t *r)
+{
+    return r->head == r->tail;
+}
+
+static inline bool input_ring_push(input_ring_t *r, uint32_t time_us, uint8_t source,
+        uint8_t device, int8_t value)
+{
+    uint32_t head = r->head;
+    uint32_t used = head - r->tail;
+    if (used >= INPUT_RING_SIZE) {
+        r->overflows++;
+        return false;
+    }
+    input_event_t *e = &r->events[head & (INPUT_RING_SIZE - 1)];
+    e->time_us = time_us;
+    e->source = source;
+    e->device = device;
+    e->value = value;
+    if (used + 1 > r->high_water) r->high_water = used + 1;
+    INPUT_RING_BARRIER();  /* The event must land before the consumer can see it */
+    r->head = head + 1;
+    return true;
+}
+
+static inline bool input_ring_pop(input_ring_t *r, input_event_t *e)
+{
+    uint32_t tail = r->tail;
+    if (tail == r->head) return false;
+    INPUT_RING_BARRIER();
+    *e = r->events[tail & (INPUT_RING_SIZE - 1)];
+    INPUT_RING_BARRIER();  /* Finish reading the slot before handing it back */
+    r->tail = tail + 1;
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INPUT_RING_H */
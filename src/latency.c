@@ -0,0 +1,200 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** @file latency.c
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "latency.h"
+
+#ifdef LATENCY_STATS
+
+typedef struct {
+    bool pending;      /* An input is waiting for this output */
+    bool in_frame;     /* ... and the frame in progress shows it */
+    uint32_t pending_us;
+    uint32_t frame_us;
+    uint32_t marked;   /* Stages marked in the frame in progress */
+    uint32_t marks_us[LATENCY_STAGES];
+} latency_output_state_t;
+
+static latency_output_state_t outputs[LATENCY_OUTPUTS];
+static latency_histogram_t histograms[LATENCY_STAGES];
+
+static const char *stage_names[LATENCY_STAGES] = {
+    "dispatch", "render start", "render end", "panel", "leds", "strip",
+};
+
+/* ---------------------------------------------------------------------- */
+
+/*  Below 4us a bucket each, then four to an octave  */
+static inline uint8_t s_bucket(uint32_t us)
+{
+    if (us < 4) {
+        return us;
+    }
+    uint8_t octave = 31 - __builtin_clz(us);
+    uint32_t b = ( octave - 1 ) * 4 + ( ( us >> ( octave - 2 ) ) & 3u );
+    return MIN(b, LATENCY_BUCKETS - 1);
+}
+
+static inline uint32_t s_bucket_floor(uint8_t b)
+{
+    if (b < 4) {
+        return b;
+    }
+    return ( 4u + ( b & 3u ) ) << ( b / 4 - 1 );
+}
+
+static void s_record(latency_stage_t stage, uint32_t us)
+{
+    latency_histogram_t *h = &histograms[stage];
+    h->count++;
+    h->max_us = MAX(h->max_us, us);
+    h->buckets[s_bucket(us)]++;
+}
+
+/* ---------------------------------------------------------------------- */
+
+/** @brief An input reached its callback.  Call on the input task. */
+void latency_input(uint32_t time_us)
+{
+    s_record(LATENCY_DISPATCH, time_us_32() - time_us);
+
+    taskENTER_CRITICAL();
+    for (uint8_t o = 0; o < LATENCY_OUTPUTS; o++) {
+        if (!outputs[o].pending) {
+            outputs[o].pending = true;
+            outputs[o].pending_us = time_us;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+
+/** @brief The output is starting a frame, which shows any input before now */
+void latency_frame_begin(latency_output_t output)
+{
+    latency_output_state_t *o = &outputs[output];
+    taskENTER_CRITICAL();
+    if (o->pending) {
+        o->in_frame = true;
+        o->frame_us = o->pending_us;
+        o->pending = false;
+        o->marked = 0;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/** @brief Held until the frame ends:  a stage marked again, as by a second
+ *         panel, moves to the later time, except the start of rendering.
+ */
+void latency_mark(latency_output_t output, latency_stage_t stage)
+{
+    latency_output_state_t *o = &outputs[output];
+    if ( o->in_frame && ( stage != LATENCY_RENDER_START || !( o->marked & ( 1u << stage ) ) ) ) {
+        o->marks_us[stage] = time_us_32();
+        o->marked |= 1u << stage;
+    }
+}
+
+/** @brief Mark the last stage of the frame from an interrupt, and end it */
+void latency_frame_end_from_isr(latency_output_t output, latency_stage_t stage)
+{
+    latency_output_state_t *o = &outputs[output];
+    if (o->in_frame) {
+        s_record(stage, time_us_32() - o->frame_us);
+        o->in_frame = false;
+    }
+}
+
+/** @brief Record the frame's marks.  A frame that marked nothing did not show
+ *         the input, so it stays pending for the next.
+ */
+void latency_frame_end(latency_output_t output)
+{
+    latency_output_state_t *o = &outputs[output];
+    if (!o->in_frame) {
+        return;
+    }
+    for (uint8_t s = 0; s < LATENCY_STAGES; s++) {
+        if ( o->marked & ( 1u << s ) ) {
+            s_record(s, o->marks_us[s] - o->frame_us);
+        }
+    }
+    taskENTER_CRITICAL();
+    if (!o->marked) {
+        o->pending = true;
+        o->pending_us = o->frame_us;
+    }
+    o->in_frame = false;
+    taskEXIT_CRITICAL();
+}
+
+/* ---------------------------------------------------------------------- */
+
+const latency_histogram_t *latency_histogram(latency_stage_t stage)
+{
+    return &histograms[stage];
+}
+
+/** @brief The top of the bucket holding the percentile, in us */
+uint32_t latency_percentile(latency_stage_t stage, uint8_t percent)
+{
+    const latency_histogram_t *h = &histograms[stage];
+    uint32_t rank = ( (uint64_t) h->count * percent + 99 ) / 100;
+    uint32_t seen = 0;
+
+    for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen >= rank && seen) {
+            return b + 1 < LATENCY_BUCKETS ? MIN(s_bucket_floor(b + 1), h->max_us) : h->max_us;
+        }
+    }
+    return 0;
+}
+
+void latency_reset()
+{
+    taskENTER_CRITICAL();
+    memset(histograms, 0, sizeof( histograms ));
+    taskEXIT_CRITICAL();
+}
+
+/** @brief One line per stage on stdout:  count, p50, p90, p99 and max in us */
+void latency_report()
+{
+    printf("%-13s %8s %8s %8s %8s %8s\n", "stage", "count", "p50", "p90", "p99", "max");
+    for (uint8_t s = 0; s < LATENCY_STAGES; s++) {
+        printf("%-13s %8lu %8lu %8lu %8lu %8lu\n", stage_names[s], histograms[s].count,
+                latency_percentile(s, 50), latency_percentile(s, 90),
+                latency_percentile(s, 99), histograms[s].max_us
+                );
+    }
+}
+
+#endif /* LATENCY_STATS */
@@ -0,0 +1,94 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LATENCY_H
+#define __LATENCY_H
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @file latency.h
+ *
+ *  @brief Input-to-photon latency, measured from the time the input handler
+ *         stamped a detent or button edge.
+ *
+ *  The oldest input not yet shown is held for each output until that output
+ *  starts a frame, and every stage of the frame is measured against it.  Each
+ *  stage keeps a histogram of four buckets per octave, so a percentile is
+ *  good to within a quarter of its power of two.  Compiled in with
+ *  LATENCY_STATS; without it the hooks are empty.
+ *
+ *  Each LED port is an output of its own:  the WS2812s, and the strip unless
+ *  WS281X_PARALLEL sends both chains through the one port.  A display frame
+ *  covering several panels counts from its first render to its last show.
+ */
+
+typedef enum latency_stage {
+    LATENCY_DISPATCH,      /**< Input to its callback */
+    LATENCY_RENDER_START,  /**< Input to the display starting to draw it */
+    LATENCY_RENDER_END,    /**< ... finishing drawing it */
+    LATENCY_PANEL,         /**< ... the panel having it */
+    LATENCY_LEDS,          /**< ... the WS2812s (or the parallel port) latching it */
+    LATENCY_STRIP,         /**< ... the strip latching it, on its own port */
+    LATENCY_STAGES
+} latency_stage_t;
+
+typedef enum latency_output {
+    LATENCY_OUTPUT_DISPLAY,
+    LATENCY_OUTPUT_LEDS,   /**< First LED port, then one output per port */
+    LATENCY_OUTPUT_STRIP,
+    LATENCY_OUTPUTS
+} latency_output_t;
+
+#define LATENCY_BUCKETS 80  /* To about two seconds */
+
+typedef struct latency_histogram {
+    uint32_t count;
+    uint32_t max_us;
+    uint32_t buckets[LATENCY_BUCKETS];
+} latency_histogram_t;
+
+#ifdef LATENCY_STATS
+void latency_input(uint32_t time_us);
+void latency_frame_begin(latency_output_t output);
+void latency_mark(latency_output_t output, latency_stage_t stage);
+void latency_frame_end_from_isr(latency_output_t output, latency_stage_t stage);
+void latency_frame_end(latency_output_t output);
+
+const latency_histogram_t *latency_histogram(latency_stage_t stage);
+uint32_t latency_percentile(latency_stage_t stage, uint8_t percent);
+void latency_reset();
+void latency_report();
+#else
+static inline void latency_input(uint32_t time_us) { }
+static inline void latency_frame_begin(latency_output_t output) { }
+static inline void latency_mark(latency_output_t output, latency_stage_t stage) { }
+static inline void latency_frame_end_from_isr(latency_output_t output, latency_stage_t stage) { }
+static inline void latency_frame_end(latency_output_t output) { }
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LATENCY_H */
@@ -0,0 +1,300 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** @file led_effect.c
+ *
+ */
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "context.h"
+#include "led_effect.h"
+#include "log.h"
+#include "ws281x.h"
+
+#define LED_FADE_TICKS        MAX(LED_FRAME_RATE * 150 / 1000, 1)  /* Crossfade, 150 ms; at least a tick */
+#define LED_BREATHE_TICKS     ( LED_FRAME_RATE * 3 )           /* One breath, 3 s */
+#define LED_CHASE_SPEED       0x0060   /* 8.8 LEDs per tick */
+#define LED_CHASE_RUN         4        /* LEDs of each colour */
+#define LED_SPARKLE_LEVELS    4        /* Palette entries per colour, brightest last */
+#define LED_SPARKLE_DECAY     6        /* Ticks per level */
+#define LED_SPARKLE_CHANCE    48       /* Of 256, that a tick lights another LED */
+
+#define LED_COLORS WS2812_PIXEL_COUNT
+
+static_assert(1 + LED_COLORS * LED_SPARKLE_LEVELS <= WS281X_PALETTE_SIZE,
+        "Sparkle palette does not fit"
+        );
+
+/*  Per chain:  all an effect needs between ticks  */
+typedef struct led_effect_state {
+    uint8_t effect;
+    bool dirty;         /* Draw on the next tick even if nothing moves */
+    uint16_t phase;     /* Effect position, its units are the effect's own */
+} led_effect_state_t;
+
+static const context_leds_t *volatile bound_leds;
+
+/*  Versions last followed:  of the bindings, and of each bound colour  */
+static const context_leds_t *seen_leds;
+static uint32_t seen_leds_version;
+static uint32_t seen_versions[WS2812_PIXEL_COUNT];
+
+/*  Crossfade, shared by every chain  */
+static uint32_t fade_from[LED_COLORS];
+static uint32_t fade_to[LED_COLORS];
+static uint32_t shown[LED_COLORS];
+static uint32_t *shown_p[LED_COLORS];
+static uint16_t fade;   /* 8.8, 0x100 when done */
+
+static led_effect_state_t states[] = {
+    [WS281X_CHAIN_WS2812] = { LED_EFFECT_STATIC, true },
+    [WS281X_CHAIN_WS2813B] = { LED_STRIP_EFFECT, true },
+};
+
+static uint8_t sparkle[WS2813B_PIXEL_COUNT];  /* Palette index of each LED */
+static uint32_t sparkle_random = 0x2545F491u;
+static uint8_t sparkle_ticks;
+
+static struct repeating_timer tick_timer;
+
+/* ---------------------------------------------------------------------- */
+
+/*  Scale each channel of rgb by an 8.8 fraction  */
+static inline uint32_t s_scale(uint32_t rgb, uint16_t f)
+{
+    return ( ( ( ( rgb >> 16 ) & 0xFF ) * f >> 8 ) << 16 ) |
+           ( ( ( ( rgb >> 8 ) & 0xFF ) * f >> 8 ) << 8 ) |
+           ( ( rgb & 0xFF ) * f >> 8 );
+}
+
+/*  Each channel from a towards b by an 8.8 fraction  */
+static inline uint32_t s_lerp(uint32_t a, uint32_t b, uint16_t f)
+{
+    uint32_t rgb = 0;
+    for (uint8_t shift = 0; shift < 24; shift += 8) {
+        int32_t ca = ( a >> shift ) & 0xFF, cb = ( b >> shift ) & 0xFF;
+        rgb |= (uint32_t) ( ca + ( ( cb - ca ) * f >> 8 ) ) << shift;
+    }
+    return rgb;
+}
+
+static inline uint32_t s_random()
+{
+    sparkle_random ^= sparkle_random << 13;
+    sparkle_random ^= sparkle_random >> 17;
+    sparkle_random ^= sparkle_random << 5;
+    return sparkle_random;
+}
+
+static bool s_tick_callback(struct repeating_timer *t)
+{
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    if (tasks.leds) {
+        xTaskNotifyIndexedFromISR(tasks.leds, NTFCN_IDX_EVENT, WS281X_TICK_BIT, eSetBits,
+                &higher_priority_task_woken
+                );
+    }
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+    return true;
+}
+
+/*
+ * Follow the bound colours, crossfading from wherever the last change got to.
+ * Nothing is read but versions until one of them moves.
+ */
+static bool s_fade_step(const context_leds_t *leds)
+{
+    bool changed = leds != seen_leds || leds->version != seen_leds_version;
+    seen_leds = leds;
+    seen_leds_version = leds->version;
+
+    for (uint8_t i = 0; i < LED_COLORS; i++) {
+        uint32_t version = leds->colors[i]->version;
+        changed |= version != seen_versions[i];
+        seen_versions[i] = version;
+    }
+    if (changed) {
+        for (uint8_t i = 0; i < LED_COLORS; i++) {
+            fade_from[i] = shown[i];
+            fade_to[i] = leds->colors[i]->rgb;
+        }
+        fade = 0;
+    }
+    if (fade >= 0x100) {
+        return false;
+    }
+
+    fade = MIN(fade + 0x100 / LED_FADE_TICKS, 0x100);
+    for (uint8_t i = 0; i < LED_COLORS; i++) {
+        shown[i] = s_lerp(fade_from[i], fade_to[i], fade);
+    }
+    return true;
+} /* s_fade_step */
+
+/* ---------------------------------------------------------------------- */
+
+static void s_strip_breathe(led_effect_state_t *s)
+{
+    s->phase += 0x10000 / LED_BREATHE_TICKS;
+
+    /*  A squared triangle wave, never quite dark  */
+    uint16_t tri = ( s->phase < 0x8000 ? s->phase : 0xFFFF - s->phase ) >> 7;
+    uint16_t level = 0x20 + ( ( tri * tri >> 8 ) * 0xE0 >> 8 );
+
+    ws281x_frame_begin(WS281X_CHAIN_WS2813B);
+    for (uint8_t i = 0; i < LED_COLORS; i++) {
+        ws281x_set_palette(WS281X_CHAIN_WS2813B, i, s_scale(shown[i], level));
+    }
+    if (s->dirty) {
+        for (uint16_t j = 0; j < WS2813B_PIXEL_COUNT; j++) {
+            ws281x_fill(WS281X_CHAIN_WS2813B, j, 1, j % LED_COLORS);
+        }
+    }
+    ws281x_show(WS281X_CHAIN_WS2813B);
+}
+
+static void s_strip_chase(led_effect_state_t *s)
+{
+    s->phase += LED_CHASE_SPEED;
+    uint16_t offset = s->phase >> 8;
+
+    ws281x_frame_begin(WS281X_CHAIN_WS2813B);
+    for (uint8_t i = 0; i < LED_COLORS; i++) {
+        ws281x_set_palette(WS281X_CHAIN_WS2813B, i, shown[i]);
+    }
+    for (uint16_t j = 0; j < WS2813B_PIXEL_COUNT; j++) {
+        ws281x_fill(WS281X_CHAIN_WS2813B, j, 1, ( ( j + offset ) / LED_CHASE_RUN ) % LED_COLORS);
+    }
+    ws281x_show(WS281X_CHAIN_WS2813B);
+}
+
+/*
+ * Palette entry 0 is off, and each colour has LED_SPARKLE_LEVELS entries of
+ * rising brightness after it.  An LED's index is all the state it needs:
+ * fading is stepping it down one entry at a time.
+ */
+static void s_strip_sparkle(led_effect_state_t *s)
+{
+    ws281x_frame_begin(WS281X_CHAIN_WS2813B);
+    ws281x_set_palette(WS281X_CHAIN_WS2813B, 0, 0u);
+    for (uint8_t i = 0; i < LED_COLORS; i++) {
+        for (uint8_t l = 0; l < LED_SPARKLE_LEVELS; l++) {
+            ws281x_set_palette(WS281X_CHAIN_WS2813B, 1 + i * LED_SPARKLE_LEVELS + l,
+                    s_scale(shown[i], ( l + 1 ) * 0x100 / LED_SPARKLE_LEVELS)
+                    );
+        }
+    }
+
+    if (++sparkle_ticks >= LED_SPARKLE_DECAY) {
+        sparkle_ticks = 0;
+        for (uint16_t j = 0; j < WS2813B_PIXEL_COUNT; j++) {
+            if (sparkle[j] && ( ( sparkle[j] - 1 ) % LED_SPARKLE_LEVELS ) == 0) {
+                sparkle[j] = 0;
+            } else if (sparkle[j]) {
+                sparkle[j]--;
+            }
+        }
+    }
+    uint32_t r = s_random();
+    if ( ( r & 0xFF ) < LED_SPARKLE_CHANCE ) {
+        uint16_t j = ( r >> 8 ) % WS2813B_PIXEL_COUNT;
+        uint8_t i = ( r >> 24 ) % LED_COLORS;
+        sparkle[j] = 1 + i * LED_SPARKLE_LEVELS + LED_SPARKLE_LEVELS - 1;
+    }
+
+    for (uint16_t j = 0; j < WS2813B_PIXEL_COUNT; j++) {
+        ws281x_fill(WS281X_CHAIN_WS2813B, j, 1, sparkle[j]);
+    }
+    ws281x_show(WS281X_CHAIN_WS2813B);
+} /* s_strip_sparkle */
+
+/* ---------------------------------------------------------------------- */
+
+/** @brief Advance every chain by one tick.  Called from the LED task. */
+void led_effect_tick()
+{
+    const context_leds_t *leds = bound_leds;
+    if (!leds) {
+        return;
+    }
+
+    bool fading = s_fade_step(leds);
+
+    led_effect_state_t *s = &states[WS281X_CHAIN_WS2812];
+    if (fading || s->dirty) {
+        ws2812_put_pixels(shown_p, LED_COLORS);
+        s->dirty = false;
+    }
+
+    s = &states[WS281X_CHAIN_WS2813B];
+    switch (s->effect) {
+    case LED_EFFECT_BREATHE:
+        s_strip_breathe(s);
+        break;
+    case LED_EFFECT_CHASE:
+        s_strip_chase(s);
+        break;
+    case LED_EFFECT_SPARKLE:
+        s_strip_sparkle(s);
+        break;
+#ifdef STRIP_KEY_COUNT
+    case LED_EFFECT_KEYS:
+        if (fading || s->dirty) {
+            ws2813b_key_pixels(shown_p, leds->notes, LED_COLORS);
+        }
+        break;
+#endif
+    default:
+        if (fading || s->dirty) {
+            ws2813b_sparkle_pixels(shown_p, LED_COLORS);
+        }
+        break;
+    } /* switch */
+    s->dirty = false;
+} /* led_effect_tick */
+
+/** @brief Follow a new set of colours.  The change crossfades in. */
+void led_effect_set_leds(const context_leds_t *leds)
+{
+    ASSERT_IS_A(leds, CONTEXT_LEDS_T);
+    bound_leds = leds;
+}
+
+void led_effect_set(ws281x_chain_id_t chain, led_effect_t effect)
+{
+    states[chain].effect = effect;
+    states[chain].phase = 0;
+    states[chain].dirty = true;
+}
+
+void led_effect_init()
+{
+    for (uint8_t i = 0; i < LED_COLORS; i++) {
+        shown_p[i] = &shown[i];
+    }
+    fade = 0x100;
+    add_repeating_timer_us(-1000000 / LED_FRAME_RATE, s_tick_callback, NULL, &tick_timer);
+}
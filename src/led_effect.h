@@ -0,0 +1,63 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __LED_EFFECT_H
+#define __LED_EFFECT_H
+
+#include "pico/stdlib.h"
+
+#include "context.h"
+#include "ws281x.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @file led_effect.h
+ *
+ *  @brief LED animation, run from the LED task on a timer tick of its own.
+ *
+ *  The bound colours are followed with a crossfade whenever one of them
+ *  changes, and the strip shows them through an effect.  Interpolation is
+ *  8.8 fixed point, and effects work on palette entries, so the per-LED cost
+ *  of a tick is a palette index.
+ */
+
+typedef enum led_effect {
+    LED_EFFECT_STATIC,   /**< The colours in turn along the strip */
+    LED_EFFECT_BREATHE,  /**< All together, fading up and down */
+    LED_EFFECT_CHASE,    /**< Runs of each colour moving along the strip */
+    LED_EFFECT_SPARKLE,  /**< Random LEDs flash a colour and fade out */
+#ifdef STRIP_KEY_COUNT
+    LED_EFFECT_KEYS,     /**< The keys of the bound notes */
+#endif
+} led_effect_t;
+
+void led_effect_init();
+void led_effect_set_leds(const context_leds_t *leds);
+void led_effect_set(ws281x_chain_id_t chain, led_effect_t effect);
+void led_effect_tick();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LED_EFFECT_H */
@@ -33,11 +33,14 @@
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
 #include "hardware/i2c.h"
+#include "hardware/spi.h"
 
 /* pico-color-picker includes */
 #include "button.h"
+#include "console.h"
 #include "context.h"
 #include "input.h"
+#include "led_effect.h"
 #include "log.h"
 #include "menu.h"
 #include "note_color.h"
@@ -83,6 +86,7 @@ void init_task(void *v)
     menu_builder_init(1, 2);
 
     menu_builder_set_render_item_cb(menu_item_render_string);
+    menu_builder_set_scrolling(MENU_SCROLL_ANIMATED);
 
     menu_builder_set_item_enter_ctx(0, cmenu_context);
     menu_builder_set_item_string(0, "1. Color menu");
@@ -109,13 +113,21 @@ int main()
     log_trace("Trace enabled.");
     log_info("%s", "Initializing PIO for LEDs...");
     ws281x_pio_init();
-
+    led_effect_init();
+
+#if defined( SCREEN_SPI )
+    log_info("%s", "Initializing SPI for screen...");
+    spi_init(SCREEN_SPI, SCREEN_SPI_BAUD);
+    gpio_set_function(SCREEN_SCK_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(SCREEN_MOSI_PIN, GPIO_FUNC_SPI);
+#elif !defined( SCREEN_MOCK )
     log_info("%s", "Initializing I2C for screen...");
     i2c_init(SCREEN_I2C, 400000);
     gpio_set_function(SCREEN_SDA_PIN, GPIO_FUNC_I2C);
     gpio_set_function(SCREEN_SCL_PIN, GPIO_FUNC_I2C);
     gpio_pull_up(SCREEN_SDA_PIN);
     gpio_pull_up(SCREEN_SCL_PIN);
+#endif
 
 
     /*
@@ -125,18 +137,25 @@ int main()
             configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 3, NULL
             );
 
-    xTaskCreate(rotary_encoder_task, "Rotary Encoders Task",
-            configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 2, &tasks.rotary_encoders
-            );
-
-    xTaskCreate(button_task, "Buttons Task",
-            configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 2, &tasks.buttons
+    xTaskCreate(input_task, "Input Task",
+            configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 2, &tasks.input
             );
 
     xTaskCreate(context_display_task, "Display Task",
             configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, &tasks.display
             );
 
+    /*  A small loop; uxTaskGetStackHighWaterMark() shows how much it uses  */
+    xTaskCreate(ws281x_task, "LED Task",
+            1024, NULL, tskIDLE_PRIORITY + 2, &tasks.leds
+            );
+
+#ifdef USB_CONSOLE
+    xTaskCreate(console_task, "Console Task",
+            1024, NULL, tskIDLE_PRIORITY + 1, NULL
+            );
+#endif
+
     vTaskStartScheduler();
 
     panic("This should not be reached.");
@@ -22,6 +22,7 @@
 
 #include "pcp.h"
 
+#include "animation.h"
 #include "button.h"
 #include "context.h"
 #include "menu.h"
@@ -42,11 +43,13 @@ struct cursor {
     uint32_t magic_number;
     menu_t *menu; /*  I hate that this needs to be here, but it simplifies callback  */
     uint8_t cursor_at;
+    tween_t scroll;  /*  Pixel offset of the rows while they slide into place  */
     void *enter_data;
 };
 
 struct menu {
     pcp_t pcp;
+    menu_scroll_t scrolling;
     uint8_t cursor_count;
     cursor_t cursors[CURSOR_MAX];
     uint8_t item_count;
@@ -61,8 +64,28 @@ struct menu_string {
     const char *v;
 };
 
+/*  In hardware scrolling mode the selected row is marked in the left margin rather than
+ *  inverted, so rows are identical wherever they sit on the screen and the
+ *  panel can scroll them in hardware.  Item renderers must leave the margin free. */
+#define MENU_MARKER_CHAR '>'
+#define MENU_ROW_HEIGHT 8  /*  One SSD1306 page  */
+
+#define MENU_SCROLL_ANIMATION_US 120000
+
 /* ------------------------------ Callbacks ------------------------- */
 
+static uint8_t s_menu_row_height(context_t *c)
+{
+    uint32_t height = context_get_drawing_pane(c)->height;
+    return ( c->use_labels ? RE_LABEL_Y_OFFSET(height) : height ) / 3;
+}
+
+static bool s_menu_hw_scroll_p(context_t *c, menu_t *menu)
+{
+    return menu->scrolling == MENU_SCROLL_HARDWARE && menu->cursor_count == 1 &&
+           s_menu_row_height(c) == MENU_ROW_HEIGHT;
+}
+
 static void s_menu_re_callback(context_t *c, void *data, v32_t v)
 {
     cursor_t *cursor = (cursor_t *) data;
@@ -71,6 +94,15 @@ static void s_menu_re_callback(context_t *c, void *data, v32_t v)
 
     cursor->cursor_at = ( cursor->cursor_at + menu->item_count + v.s ) %
                         menu->item_count;
+    if ( s_menu_hw_scroll_p(c, menu) ) {
+        context_request_scroll(c, v.s);
+    } else if (menu->scrolling == MENU_SCROLL_ANIMATED) {
+        /*  Start from wherever the rows are now, so quick turns chain smoothly  */
+        int16_t row_height = s_menu_row_height(c);
+        int16_t from = tween_value(&cursor->scroll, time_us_32() ) + v.s * row_height;
+        from = MAX(MIN(from, 2 * row_height), -2 * row_height);
+        tween_start(&cursor->scroll, from, 0, MENU_SCROLL_ANIMATION_US, EASE_OUT);
+    }
     if (menu->selection_changed_cb) {
         menu->selection_changed_cb(menu);
     }
@@ -82,26 +114,35 @@ static void s_menu_ui_callback(context_t *c, void *data, v32_t v)
     ASSERT_IS_A(menu, MENU_T);
 
     bitmap_t *pane = context_get_drawing_pane(c);
-    uint8_t height = c->use_labels ? RE_LABEL_Y_OFFSET : SCREEN_HEIGHT;
-    bitmap_t *item_bitmap = bitmap_alloc(pane->width / menu->cursor_count, height / 3, NULL);
+    int32_t row_height = s_menu_row_height(c);
+    bitmap_t *item_bitmap = bitmap_alloc(pane->width / menu->cursor_count, row_height, NULL);
+    bool hw_scroll = s_menu_hw_scroll_p(c, menu);
+    uint32_t now_us = time_us_32();
 
     for (uint8_t cursor = 0; cursor < menu->cursor_count; cursor++) {
-        uint8_t offset = ( menu->cursors[cursor].cursor_at + menu->item_count - 1 ) %
-                         menu->item_count;
-        bitmap_clear(item_bitmap);
-        menu->render_item_cb(&menu->items[offset], item_bitmap, cursor);
-        bitmap_copy_from(pane, item_bitmap, cursor * item_bitmap->width, 0);
-
-        bitmap_clear(item_bitmap);
-        offset = ( offset + 1 ) % menu->item_count;
-        menu->render_item_cb(&menu->items[offset], item_bitmap, cursor);
-        bitmap_invert(item_bitmap);
-        bitmap_copy_from(pane, item_bitmap, cursor * item_bitmap->width, height / 3);
-
-        bitmap_clear(item_bitmap);
-        offset = ( offset + 1 ) % menu->item_count;
-        menu->render_item_cb(&menu->items[offset], item_bitmap, cursor);
-        bitmap_copy_from(pane, item_bitmap, cursor * item_bitmap->width, 2 * height / 3);
+        int32_t scroll = tween_value(&menu->cursors[cursor].scroll, now_us);
+
+        /*  Rows -1..1 are on screen at rest; a scroll offset of up to two rows
+         *  either way can bring two more in at each edge.  */
+        for (int8_t row = -3; row <= 3; row++) {
+            int32_t y = ( row + 1 ) * row_height + scroll;
+            if ( y <= -row_height || y >= 3 * row_height ) {
+                continue;
+            }
+            uint8_t offset = ( menu->cursors[cursor].cursor_at + 3 * menu->item_count + row ) %
+                             menu->item_count;
+
+            bitmap_clear(item_bitmap);
+            menu->render_item_cb(&menu->items[offset], item_bitmap, cursor);
+            if (row == 0) {
+                if (hw_scroll) {
+                    bitmap_draw_char(item_bitmap, 0, 0, &TRIPLE_LINE_TEXT_FONT, MENU_MARKER_CHAR);
+                } else {
+                    bitmap_invert(item_bitmap);
+                }
+            }
+            bitmap_copy_from_offset(pane, item_bitmap, cursor * item_bitmap->width, y);
+        }
     }
 
     pcp_free(item_bitmap);
@@ -260,6 +301,13 @@ void menu_builder_set_selection_changed_cb( void ( *f )(menu_t *) )
     m->selection_changed_cb = f;
 }
 
+void menu_builder_set_scrolling(menu_scroll_t scrolling)
+{
+    menu_t *m = (menu_t *) pvTaskGetThreadLocalStoragePointer(NULL, ThLS_BLDR_MENU);
+    ASSERT_IS_A(m, MENU_T);
+    m->scrolling = scrolling;
+}
+
 void menu_builder_set_render_item_cb( void ( *f )(menu_item_t *, bitmap_t *, uint8_t) )
 {
     menu_t *m = (menu_t *) pvTaskGetThreadLocalStoragePointer(NULL, ThLS_BLDR_MENU);
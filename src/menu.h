@@ -32,9 +32,17 @@ extern "C" {
 typedef struct menu_item menu_item_t;
 typedef struct menu menu_t;
 
+/** @brief How the rows move when a cursor is turned */
+typedef enum menu_scroll {
+    MENU_SCROLL_JUMP,     /**< Redraw the rows in place */
+    MENU_SCROLL_HARDWARE, /**< Move the rows with the panel's display start line */
+    MENU_SCROLL_ANIMATED, /**< Slide the rows into place over a few frames */
+} menu_scroll_t;
+
 /* Menu builder functions */
 void menu_builder_init(uint8_t cursors, uint8_t items);
 void menu_builder_set_selection_changed_cb(void ( * )(menu_t *) );
+void menu_builder_set_scrolling(menu_scroll_t scrolling);
 void menu_builder_set_render_item_cb(void ( * )(menu_item_t *,
         bitmap_t *,
         uint8_t
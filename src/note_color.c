@@ -35,10 +35,14 @@
 #include "bitmap.h"
 #include "button.h"
 #include "context.h"
+#include "gesture.h"
+#include "hsv.h"
+#include "led_effect.h"
 #include "menu.h"
 #include "note_color.h"
+#include "ws281x.h"
 
-#define CELL_WIDTH ( RE_LABEL_TOTAL_WIDTH / 3 )
+#define CELL_WIDTH( c ) ( context_get_drawing_pane(c)->width / 3 )
 #define CELL_HEIGHT ( TRIPLE_LINE_TEXT_FONT.Height )
 
 /* ---------------------------------------------------------------------- */
@@ -47,7 +51,7 @@
 struct note_color {
     uint32_t magic_number;
     const char *note_name;
-    uint32_t rgb;
+    led_color_t color;
     context_t *rgbe_ctx;
 };
 
@@ -59,16 +63,26 @@ typedef struct {
     uint8_t button_offset;
 } rgb_encoder_t;
 
+/** @brief What the three encoders turn:  the channels, or hue, saturation and value */
+typedef enum rgbe_mode {
+    RGBE_MODE_RGB,
+    RGBE_MODE_HSV,
+} rgbe_mode_t;
+
 typedef struct rgb_encoders_data {
     pcp_t pcp;
     SemaphoreHandle_t rgbe_mutex;
-    uint32_t *rgb;
-    rgb_encoder_t rgb_encoders[IO_PIO_SLOTS / 2]; /*  We waste storage to simplify lookup.  Maybe not necessary with callbacks?  */
+    led_color_t *color;
+    rgbe_mode_t mode;
+    uint16_t hue;           /*  0 to HUE_RANGE - 1, kept through greys  */
+    uint8_t saturation;
+    uint8_t value;
+    rgb_encoder_t rgb_encoders[RE_COUNT]; /*  We waste storage to simplify lookup.  Maybe not necessary with callbacks?  */
 } rgb_encoders_data_t;
 
 typedef struct rgb_encoder_frame {
     pcp_t pcp;
-    void ( *line1 )(menu_t *, uint8_t);
+    void ( *line1 )(context_t *, menu_t *, uint8_t);
     menu_t *menu;
     uint8_t cursor;
 } rgb_encoder_frame_t;
@@ -87,6 +101,17 @@ static uint32_t initial_rgbs[NOTE_COUNT] = {
     0x00cd71, 0x008AA1, 0x2161b0, 0x2200ff, 0x860e90, 0xB8154A
 };
 
+#ifndef RGBE_DEFAULT_MODE
+#define RGBE_DEFAULT_MODE RGBE_MODE_RGB
+#endif
+
+/* ---------------------------------------------------------------------- */
+
+static const char *rgbe_labels[2][3] = {
+    [RGBE_MODE_RGB] = { "Red", "Green", "Blue" },
+    [RGBE_MODE_HSV] = { "Hue", "Sat", "Val" },
+};
+
 /* ---------------------------------------------------------------------- */
 
 static note_color_t note_colors[NOTE_COUNT];
@@ -96,7 +121,7 @@ static context_leds_t rgbe_leds;
 /* ---------------------------------------------------------------------- */
 
 static rgb_encoder_frame_t *s_rgb_encoder_frame_alloc(
-        void ( *line1 )(menu_t *, uint8_t), menu_t *menu, uint8_t cursor)
+        void ( *line1 )(context_t *, menu_t *, uint8_t), menu_t *menu, uint8_t cursor)
 {
     rgb_encoder_frame_t *f = pcp_zero_malloc(sizeof( rgb_encoder_frame_t ) );
     f->pcp.magic_number = RGB_ENCODER_FRAME_T | FREEABLE_P;
@@ -113,7 +138,7 @@ static uint32_t s_rgbes_value(rgb_encoders_data_t *re)
 {
     uint32_t rgb = 0u;
     xSemaphoreTake(re->rgbe_mutex, portMAX_DELAY);
-    for (int i = 0; i<4; i++) {
+    for (int i = 0; i<RE_COUNT; i++) {
         if (re->rgb_encoders[i].active) {
             rgb |= re->rgb_encoders[i].value << re->rgb_encoders[i].shift;
         }
@@ -122,11 +147,50 @@ static uint32_t s_rgbes_value(rgb_encoders_data_t *re)
     return rgb;
 } /* s_rgbes_value */
 
+/*
+ * One detent in HSV mode.  The encoders' channel values are kept in step
+ * with the colour, so the display and a switch back to RGB see the same
+ * thing.
+ */
+static void s_rgbes_hsv_detent(rgb_encoders_data_t *red, rgb_encoder_t *re, int32_t delta)
+{
+    bool fine = button_depressed_p(re->button_offset);
+
+    xSemaphoreTake(red->rgbe_mutex, portMAX_DELAY);
+    switch (re->shift) {
+    case 16:
+        red->hue = ( red->hue + delta * ( fine ? 4 : 32 ) % HUE_RANGE + HUE_RANGE ) % HUE_RANGE;
+        break;
+    case 8:
+        red->saturation = MIN(MAX(red->saturation + delta * ( fine ? 1 : 0x11 ), 0), 0xff);
+        break;
+    default:
+        red->value = MIN(MAX(red->value + delta * ( fine ? 1 : 0x11 ), 0), 0xff);
+        break;
+    }
+    uint32_t rgb = hsv_to_rgb(red->hue, red->saturation, red->value);
+    for (int i = 0; i<RE_COUNT; i++) {
+        if (red->rgb_encoders[i].active) {
+            red->rgb_encoders[i].value = rgb >> red->rgb_encoders[i].shift & 0xff;
+        }
+    }
+    xSemaphoreGive(red->rgbe_mutex);
+
+    led_color_set(red->color, rgb);
+} /* s_rgbes_hsv_detent */
+
 static void s_rgbes_re_callback(context_t *c, void *re_v, v32_t delta)
 {
     rgb_encoder_t *re = (rgb_encoder_t *) re_v;
     assert(re->magic_number == RGB_ENCODER_T);
 
+    rgb_encoders_data_t *red = (rgb_encoders_data_t *) c->data;
+    ASSERT_IS_A(red, RGB_ENCODERS_DATA_T);
+    if (red->mode == RGBE_MODE_HSV) {
+        s_rgbes_hsv_detent(red, re, delta.s);
+        return;
+    }
+
     log_trace("RGB Encoder initial value %02x", re->value);
 
     int16_t value = re->value;
@@ -136,9 +200,9 @@ static void s_rgbes_re_callback(context_t *c, void *re_v, v32_t delta)
     value = MIN(value, 0xff);
     re->value = value;
 
-    rgb_encoders_data_t *red = (rgb_encoders_data_t *) c->data;
-    ASSERT_IS_A(red, RGB_ENCODERS_DATA_T);
-    *red->rgb = s_rgbes_value( (rgb_encoders_data_t *) c->data);
+    uint32_t rgb = s_rgbes_value(red);
+    hsv_from_rgb(rgb, &red->hue, &red->saturation, &red->value);
+    led_color_set(red->color, rgb);
 
     log_trace("RGB Encoder new value %02x", re->value);
 }; /* s_rgbes_re_callback */
@@ -167,10 +231,10 @@ static void s_rgbe_display_callback(context_t *c, void *data, v32_t v)
             re->rgb_encoders[RE_BLUE_OFFSET].value
             );
 
-    sprintf(hex_color_value, "#%06lx", (unsigned long) *re->rgb);
+    sprintf(hex_color_value, "#%06lx", (unsigned long) re->color->rgb);
 
     if (f) {
-        f->line1(f->menu, f->cursor);
+        f->line1(c, f->menu, f->cursor);
     }
     bitmap_draw_string(context_get_drawing_pane(c), 0,
             TRIPLE_LINE_TEXT_FONT.Height, &DOUBLE_LINE_TEXT_FONT,
@@ -178,7 +242,40 @@ static void s_rgbe_display_callback(context_t *c, void *data, v32_t v)
             );
 } /* s_rgbe_display_callback */
 
-static context_t *s_rgbe_init(uint32_t *rgb)
+static void s_rgbes_set_mode(context_t *c, rgb_encoders_data_t *red, rgbe_mode_t mode)
+{
+    red->mode = mode;
+    context_set_re_label(c, RE_RED_OFFSET, rgbe_labels[mode][0]);
+    context_set_re_label(c, RE_GREEN_OFFSET, rgbe_labels[mode][1]);
+    context_set_re_label(c, RE_BLUE_OFFSET, rgbe_labels[mode][2]);
+    context_set_lower_button_char(c, mode == RGBE_MODE_RGB ? 'H' : 'R');
+}
+
+/*
+ *  Lower button:  a click switches between turning RGB and HSV, a long press
+ *  steps the LEDs down through half brightness each time, then back to full
+ */
+static void s_rgbes_lower_gesture_callback(context_t *c, void *data, v32_t value)
+{
+    rgb_encoders_data_t *red = (rgb_encoders_data_t *) c->data;
+    ASSERT_IS_A(red, RGB_ENCODERS_DATA_T);
+    uint8_t brightness = ws281x_brightness();
+
+    switch ( gesture_type(value) ) {
+    case GESTURE_CLICK:
+        s_rgbes_set_mode(c, red, red->mode == RGBE_MODE_RGB ? RGBE_MODE_HSV : RGBE_MODE_RGB);
+        context_notify_display_task(c);
+        break;
+    case GESTURE_LONG_PRESS:
+        ws281x_set_brightness(brightness >= 32 ? brightness / 2 : 255);
+        log_info("LED brightness %d", ws281x_brightness());
+        break;
+    default:
+        break;
+    }
+}
+
+static context_t *s_rgbe_init(led_color_t *color)
 {
     /*
      *  Step 1 - Initialize the underlying data storage object for the context
@@ -189,7 +286,9 @@ static context_t *s_rgbe_init(uint32_t *rgb)
     rgbes->pcp.free_f = vPortFree;
     rgbes->pcp.autofree_p = true;
     rgbes->rgbe_mutex = xSemaphoreCreateMutex();
-    rgbes->rgb = rgb;
+    rgbes->color = color;
+    uint32_t rgb = color->rgb;
+    hsv_from_rgb(rgb, &rgbes->hue, &rgbes->saturation, &rgbes->value);
 
     log_trace("Start context build for RGB Encoder");
     context_builder_init();
@@ -202,17 +301,17 @@ static context_t *s_rgbe_init(uint32_t *rgb)
     rgbes->rgb_encoders[RE_RED_OFFSET].active = true;
     rgbes->rgb_encoders[RE_RED_OFFSET].shift = 16;
     rgbes->rgb_encoders[RE_RED_OFFSET].button_offset = BUTTON_RED_OFFSET;
-    rgbes->rgb_encoders[RE_RED_OFFSET].value = *rgb >> 16 & 0xff;
+    rgbes->rgb_encoders[RE_RED_OFFSET].value = rgb >> 16 & 0xff;
     rgbes->rgb_encoders[RE_GREEN_OFFSET].magic_number = RGB_ENCODER_T;
     rgbes->rgb_encoders[RE_GREEN_OFFSET].active = true;
     rgbes->rgb_encoders[RE_GREEN_OFFSET].shift = 8;
     rgbes->rgb_encoders[RE_GREEN_OFFSET].button_offset = BUTTON_GREEN_OFFSET;
-    rgbes->rgb_encoders[RE_GREEN_OFFSET].value = *rgb >> 8 & 0xff;
+    rgbes->rgb_encoders[RE_GREEN_OFFSET].value = rgb >> 8 & 0xff;
     rgbes->rgb_encoders[RE_BLUE_OFFSET].magic_number = RGB_ENCODER_T;
     rgbes->rgb_encoders[RE_BLUE_OFFSET].active = true;
     rgbes->rgb_encoders[RE_BLUE_OFFSET].shift = 0;
     rgbes->rgb_encoders[RE_BLUE_OFFSET].button_offset = BUTTON_BLUE_OFFSET;
-    rgbes->rgb_encoders[RE_BLUE_OFFSET].value = *rgb & 0xff;
+    rgbes->rgb_encoders[RE_BLUE_OFFSET].value = rgb & 0xff;
 
     /*
      *  Step 3 - Define context.
@@ -226,16 +325,22 @@ static context_t *s_rgbe_init(uint32_t *rgb)
     context_builder_set_blue_re(s_rgbes_re_callback,
             &rgbes->rgb_encoders[RE_BLUE_OFFSET], NULL, NULL, "Blue"
             );
+    context_builder_set_re_acceleration(true);
 
     context_builder_set_upper_button(button_return_callback, NULL, LAQUO);
 
+    context_builder_set_lower_button(NULL, NULL, 'H');
+    context_builder_set_gesture(BUTTON_LOWER_OFFSET, s_rgbes_lower_gesture_callback, NULL);
+
     context_builder_set_display_callback(s_rgbe_display_callback, rgbes);
 
     context_builder_set_data(rgbes);
 
 
     log_trace("Finalizing context build for RGB Encoder");
-    return context_builder_finalize();
+    context_t *c = context_builder_finalize();
+    s_rgbes_set_mode(c, rgbes, RGBE_DEFAULT_MODE);
+    return c;
 } /* s_rgbe_init */
 
 static void s_menu_render_item_callback(menu_item_t *item,
@@ -247,7 +352,7 @@ static void s_menu_render_item_callback(menu_item_t *item,
     assert(cursor == 0);
 
     bitmap_clear(item_bitmap);
-    sprintf(buffer, "%-5s #%06lx", nc->note_name, (unsigned long) nc->rgb);
+    sprintf(buffer, "%-5s #%06lx", nc->note_name, (unsigned long) nc->color.rgb);
     bitmap_draw_string(item_bitmap, 8, 0, &TRIPLE_LINE_TEXT_FONT, buffer);
 }
 
@@ -266,18 +371,22 @@ static void s_chord_render_item_callback(menu_item_t *item,
             );
 } /* s_chord_render_item_callback */
 
-static void s_menu_line1_render_callback(menu_t *m, uint8_t cursor)
+static void s_menu_line1_render_callback(context_t *c, menu_t *m, uint8_t cursor)
 {
     s_menu_render_item_callback(menu_item_at_cursor(m, cursor, 0),
-            context_get_drawing_pane(NULL), cursor
+            context_get_drawing_pane(c), cursor
             );
 }
 
-static void s_chord_line1_render_callback(menu_t *m, uint8_t cursor)
+static void s_chord_line1_render_callback(context_t *c, menu_t *m, uint8_t cursor)
 {
     static bitmap_t *item_bitmap;
+    if (item_bitmap && item_bitmap->width != CELL_WIDTH(c)) {
+        pcp_free(item_bitmap);
+        item_bitmap = NULL;
+    }
     if (!item_bitmap) {
-        item_bitmap = bitmap_alloc(CELL_WIDTH, CELL_HEIGHT, NULL);
+        item_bitmap = bitmap_alloc(CELL_WIDTH(c), CELL_HEIGHT, NULL);
     }
 
     for (uint8_t i = 0; i<3; i++) {
@@ -285,7 +394,7 @@ static void s_chord_line1_render_callback(menu_t *m, uint8_t cursor)
         if (i == cursor) {
             bitmap_invert(item_bitmap);
         }
-        bitmap_copy_from(context_get_drawing_pane(NULL), item_bitmap, CELL_WIDTH * i, 0);
+        bitmap_copy_from(context_get_drawing_pane(c), item_bitmap, CELL_WIDTH(c) * i, 0);
     }
 } /* s_chord_line1_render_callback */
 
@@ -293,24 +402,26 @@ static void s_menu_selection_changed_callback(menu_t *menu)
 {
     rgbe_leds.magic_number = CONTEXT_LEDS_T;
     uint8_t i = menu_cursor_at(menu, 0);
-    rgbe_leds.rgb_p[0] = &note_colors[( i + NOTE_COUNT - 1 ) % NOTE_COUNT].rgb;
-    rgbe_leds.rgb_p[1] = &note_colors[i].rgb;
-    rgbe_leds.rgb_p[2] = &note_colors[( i + 1 ) % NOTE_COUNT].rgb;
+    for (uint8_t j = 0; j<3; j++) {
+        rgbe_leds.notes[j] = ( i + NOTE_COUNT - 1 + j ) % NOTE_COUNT;
+        rgbe_leds.colors[j] = &note_colors[rgbe_leds.notes[j]].color;
+    }
+    rgbe_leds.version++;
 }
 
 static void s_chord_selection_changed_callback(menu_t *menu)
 {
     rgbe_leds.magic_number = CONTEXT_LEDS_T;
     for (uint8_t i = 0; i<3; i++) {
-        rgbe_leds.rgb_p[i] = &note_colors[menu_cursor_at(menu, i)].rgb;
+        rgbe_leds.notes[i] = menu_cursor_at(menu, i);
+        rgbe_leds.colors[i] = &note_colors[rgbe_leds.notes[i]].color;
     }
+    rgbe_leds.version++;
 }
 
 static void s_color_menu_entry(context_t *c, void *data, v32_t v)
 {
-    xTaskNotifyIndexed(tasks.display, NTFCN_IDX_LEDS, (uint32_t) &rgbe_leds,
-            eSetValueWithOverwrite
-            );
+    led_effect_set_leds(&rgbe_leds);
 }
 
 /* ---------------------------------------------------------------------- */
@@ -320,9 +431,9 @@ void note_color_init()
     for (uint8_t i = 0; i<12; i++) {
         note_colors[i].magic_number = NOTE_COLOR_T;
         note_colors[i].note_name = initial_names[i];
-        note_colors[i].rgb = initial_rgbs[i];
+        note_colors[i].color.rgb = initial_rgbs[i];
         log_trace("Initializing RGB Encoder #%d", i);
-        note_colors[i].rgbe_ctx = s_rgbe_init(&note_colors[i].rgb);
+        note_colors[i].rgbe_ctx = s_rgbe_init(&note_colors[i].color);
     }
 }
 
@@ -345,6 +456,7 @@ context_t *note_color_menu_alloc()
 
     menu_builder_set_render_item_cb(s_menu_render_item_callback);
     menu_builder_set_selection_changed_cb(s_menu_selection_changed_callback);
+    menu_builder_set_scrolling(MENU_SCROLL_HARDWARE);
     context_builder_set_enable_callback(s_color_menu_entry, 0);
     context_builder_set_upper_button(button_return_callback, NULL, LAQUO);
 
@@ -369,6 +481,8 @@ context_t *note_color_chord_alloc()
 
     menu_builder_set_render_item_cb(s_chord_render_item_callback);
     menu_builder_set_selection_changed_cb(s_chord_selection_changed_callback);
+    menu_builder_set_scrolling(MENU_SCROLL_ANIMATED);
+    context_builder_set_panel(SCREEN_CHORD_PANEL);
     context_builder_set_enable_callback(s_color_menu_entry, 0);
     context_builder_set_upper_button(button_return_callback, NULL, LAQUO);
 
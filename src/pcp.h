@@ -85,9 +85,9 @@ typedef void (*context_callback_f)( context_t *c, void *, v32_t );
 #define ThLS_BLDR_MENU          1
 
 /* NOTIFICATION INDICES */
+#define NTFCN_IDX_TRANSFER      0
 #define NTFCN_IDX_EVENT         1
 #define NTFCN_IDX_CONTEXT       2
-#define NTFCN_IDX_LEDS          2
 
 /* ----------------------------------------------------------------------- */
 
@@ -110,8 +110,9 @@ static inline void pcp_free( void *v )
 
 /* CONVENIENT FORMATTING EXPRESSIONS */
 
-#define RE_LABEL_Y_OFFSET ( SCREEN_HEIGHT - RE_LABEL_FONT.Height )
-#define RE_LABEL_TOTAL_WIDTH ( SCREEN_WIDTH - BUTTON_LABEL_FONT.Width )
+/*  In terms of the height and width of the panel being drawn  */
+#define RE_LABEL_Y_OFFSET( h ) ( ( h ) - RE_LABEL_FONT.Height )
+#define RE_LABEL_TOTAL_WIDTH( w ) ( ( w ) - BUTTON_LABEL_FONT.Width )
 
 static inline void *pcp_zero_malloc( size_t s )
 {
@@ -26,7 +26,9 @@
 
 #include "context.h"
 #include "input.h"
+#include "latency.h"
 #include "log.h"
+#include "rotary_encoder.h"
 
 #define PIOx __CONCAT(pio, IO_DEVICES_PIO)
 
@@ -49,7 +51,29 @@ typedef struct {
 #endif
 } rotary_encoder_info_t;
 
-static rotary_encoder_info_t rotary_encoders[4];
+static rotary_encoder_info_t rotary_encoders[RE_COUNT];
+static input_scan_t rotary_encoder_scan = INPUT_SCAN_INIT;
+
+/*
+ * Acceleration: the gap since the previous detent of the same encoder, in the
+ * same direction, picks a multiplier for the detent.  Rows are tried in order
+ * and the first whose bound the gap is under wins; slower turns step by one.
+ */
+#ifndef RE_ACCEL_TABLE
+#define RE_ACCEL_TABLE { 12000, 6 }, { 25000, 3 }, { 50000, 2 }
+#endif
+
+static const rotary_encoder_accel_t re_accel[] = { RE_ACCEL_TABLE };
+#define RE_ACCEL_STEPS (sizeof(re_accel) / sizeof(re_accel[0]))
+static_assert(RE_ACCEL_STEPS < RE_ACCEL_BUCKETS, "RE_ACCEL_TABLE has too many rows");
+
+typedef struct {
+  uint32_t time_us;  /* Of the last detent */
+  int8_t direction;
+} rotary_encoder_last_t;
+
+static rotary_encoder_last_t rotary_encoder_last[RE_COUNT];
+static rotary_encoder_stats_t rotary_encoder_stats_[RE_COUNT];
 
 static const int8_t transitions[16] = {
         0,    // 0 00 -> 00 no movement
@@ -70,17 +94,20 @@ static const int8_t transitions[16] = {
         0,    // F 11 -> 11 no movement
 };
 
-__isr static void rotary_encoder_interrupt_handler(PIO pio, uint8_t sm, TaskHandle_t task_to_signal) {
-  uint32_t notify_bits = 0u;
-
-  while(pio_sm_get_rx_fifo_level(pio, sm)) {
-    uint32_t pio_rx = pio_sm_get(pio, sm);
+__isr static void rotary_encoder_decode(uint32_t pio_rx, uint32_t time_us) {
+    uint32_t prior, now;
+    input_scan_word(&rotary_encoder_scan, pio_rx, &prior, &now);
 
     /*
-     * Step 1 - decipher the bits coming from the PIO (Rotary Encoders)
+     * Step 1 - decipher the bits coming from the PIO (Rotary Encoders), visiting
+     *          only the encoders that moved
      */
-    for(int i=0; i<4; i++) {
-      uint16_t rx = pio_rx >> (i*2);
+    for(uint32_t moved = prior ^ now; moved; ) {
+      int i = __builtin_ctz(moved) / 2;
+      moved &= ~(3u << (i*2));
+      if (i >= RE_COUNT) break;
+
+      uint16_t rx = ((now >> (i*2)) & 0x3u) << 8 | ((prior >> (i*2)) & 0x3u);
       uint8_t prior_state, new_state;
       rotary_encoder_info_t *re = &rotary_encoders[i];
 
@@ -93,7 +120,6 @@ __isr static void rotary_encoder_interrupt_handler(PIO pio, uint8_t sm, TaskHand
         prior_state = rx & 0x3u;                        /* X..XA'B' -> A'B' */
         new_state = (rx & 0x300u)>>8;                     /* ABX..X -> AB */
       }
-      if(new_state == prior_state) continue;
 
       /*
        * Step 2 - construct an index to the callback table
@@ -106,11 +132,11 @@ __isr static void rotary_encoder_interrupt_handler(PIO pio, uint8_t sm, TaskHand
       re->sub_count += transitions[idx];
       if (re->sub_count >= RE_DIVISOR) {
         /* debug_printf("RE %d +1 (index %d)", i, transition_history_idx); */
-        notify_bits |= 1 << (i*2);
+        input_ring_push(&input_events, time_us, INPUT_ENCODER, i, +1);
         re->sub_count = 0;
       } else if (re->sub_count <= RE_DIVISOR * -1) {
         /* debug_printf("RE %d -1 (index %d)", i, transition_history_idx); */
-        notify_bits |= 1 << (i*2+1);
+        input_ring_push(&input_events, time_us, INPUT_ENCODER, i, -1);
         re->sub_count = 0;
       }
 #ifdef PCP_TRACK_TRANSITIONS
@@ -121,17 +147,19 @@ __isr static void rotary_encoder_interrupt_handler(PIO pio, uint8_t sm, TaskHand
       transition_history_idx++;
 #endif
     }
-  }
+}
+
+#ifndef INPUT_DMA
+__isr static void rotary_encoder_interrupt_handler(PIO pio, uint8_t sm, TaskHandle_t task_to_signal) {
+  uint32_t head = input_events.head;
 
-  if (notify_bits) {
-    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    xTaskNotifyIndexedFromISR(task_to_signal, 1,
-        notify_bits,
-        eSetBits,
-        &xHigherPriorityTaskWoken);
-    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+  while(pio_sm_get_rx_fifo_level(pio, sm)) {
+    rotary_encoder_decode(pio_sm_get(pio, sm), time_us_32());
   }
+
+  if (input_events.head != head) input_ring_notify_from_isr(task_to_signal);
 }
+#endif
 
 static void rotary_encoder_register( uint8_t re_number, bool inverted) {
   rotary_encoders[re_number].inverted = inverted;
@@ -142,51 +170,69 @@ static void rotary_encoder_register( uint8_t re_number, bool inverted) {
 #endif
 }
 
-static void rotary_encoder_init(uint8_t low_pin, uint8_t sm) {
+void rotary_encoder_init(uint8_t low_pin, uint8_t sm) {
+  rotary_encoder_register(RE_RED_OFFSET, RE_RED_INVERTED);
+  rotary_encoder_register(RE_GREEN_OFFSET, RE_GREEN_INVERTED);
+  rotary_encoder_register(RE_BLUE_OFFSET, RE_BLUE_INVERTED);
+
   log_trace("Initializing encoders on SM %d", sm);
-  for(uint8_t re=0; re<4; re++) {
+#ifdef INPUT_SHIFT_REGISTERS
+  /* Every encoder on the chain is read; the three above keep their wiring */
+  for(uint8_t re=0; re<RE_COUNT; re++) {
+    if(!rotary_encoders[re].enabled) rotary_encoder_register(re, false);
+  }
+  input_init_shift_sm(RE_SR_LOAD_PIN, RE_SR_DATA_PIN, sm, RE_COUNT * 2);
+#else
+  for(uint8_t re=0; re<RE_COUNT; re++) {
     if(!rotary_encoders[re].enabled) continue;
     for(uint8_t i=0; i<2; i++) input_init_pin(low_pin + re*2 + i);
   }
-  input_init_sm(low_pin, sm);
+  input_init_sm(low_pin, sm, RE_STABLE_SAMPLES);
+#endif
+#ifdef INPUT_DMA
+  input_dma_capture(PIOx, sm, rotary_encoder_decode);
+#else
   input_pio_irq_set_handler(PIOx, sm,
       rotary_encoder_interrupt_handler, xTaskGetCurrentTaskHandle(),
       PIO_INTR_SM0_RXNEMPTY_BITS);
+#endif
 }
 
-void rotary_encoder_task(void *parm) {
-  context_t *context = NULL;
-
-  rotary_encoder_register(RE_RED_OFFSET, RE_RED_INVERTED);
-  rotary_encoder_register(RE_GREEN_OFFSET, RE_GREEN_INVERTED);
-  rotary_encoder_register(RE_BLUE_OFFSET, RE_BLUE_INVERTED);
-  rotary_encoder_init(RE_LOW_PIN, RE_SM);
-
-  uint32_t bits = 0u;
-
-  for( ;; ) {
-    /* Update the context if necessary */
-    do {
-      xTaskNotifyWaitIndexed(NTFCN_IDX_CONTEXT, 0u, 0u, (uint32_t *)(&context), context? 0 : portMAX_DELAY);
-    } while(!context);
-
-    ASSERT_IS_A(context, CONTEXT_T);
-
-    log_trace("Processing Rotary Encoder input");
-    for (int i=0; context && i<4; i++, bits >>= 2) {
-      context_callback_t *c = &context->re_ccb[i];
-      if(!c->callback || !(bits & 3u)) continue;
-      v32_t delta = (v32_t)((int32_t)0);
-      if(bits & 1u) delta.s=1;
-      if(bits & 2u) delta.s=-1;
-      log_trace("Sending delta %d to RE %d", delta.s, i);
-      c->callback(context, c->data, delta);
+static int32_t s_rotary_encoder_accelerate(const input_event_t *e) {
+  rotary_encoder_last_t *last = &rotary_encoder_last[e->device];
+  rotary_encoder_stats_t *stats = &rotary_encoder_stats_[e->device];
+  uint32_t interval = e->time_us - last->time_us;
+  uint8_t row = RE_ACCEL_STEPS;  /* No row: a single step */
+
+  /* A reversal starts over, so backing off an overshoot is always fine */
+  if (last->direction == e->value) {
+    for (row = 0; row < RE_ACCEL_STEPS && interval >= re_accel[row].below_us; row++);
+    stats->interval_us = interval;
+    if (interval < stats->interval_us_min || !stats->interval_us_min) {
+      stats->interval_us_min = interval;
     }
+  }
+  last->time_us = e->time_us;
+  last->direction = e->value;
+
+  int32_t steps = row < RE_ACCEL_STEPS ? re_accel[row].multiplier : 1;
+  stats->detents++;
+  stats->steps += steps;
+  stats->by_row[row]++;
+  return e->value * steps;
+}
 
-    log_trace("Rotary encoder->UI Notification");
-    context_notify_display_task(context);
+void rotary_encoder_event(context_t *context, const input_event_t *e) {
+  int32_t delta = s_rotary_encoder_accelerate(e);
+  context_callback_t *c = &context->re_ccb[e->device];
+  if(!c->callback) return;
+  if(!context->re_accelerated) delta = e->value;
+  log_trace("Sending delta %ld to RE %d", delta, e->device);
+  latency_input(e->time_us);
+  c->callback(context, c->data, (v32_t)delta);
+}
 
-    /* Spin-wait for the next event */
-    while (!xTaskNotifyWaitIndexed(NTFCN_IDX_EVENT, 0u, 0xFFFFFFFFu, &bits, portMAX_DELAY));
-  }
+const rotary_encoder_stats_t *rotary_encoder_stats(uint8_t re) {
+  assert(re < RE_COUNT);
+  return &rotary_encoder_stats_[re];
 }
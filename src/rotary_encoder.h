@@ -23,11 +23,35 @@
 
 #include "pico/stdlib.h"
 
+#include "context.h"
+#include "input.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-void rotary_encoder_task(void *);
+/** @brief One row of the acceleration table: detents closer together than
+ *         below_us move the value multiplier steps.
+ */
+typedef struct rotary_encoder_accel {
+  uint32_t below_us;
+  uint8_t multiplier;
+} rotary_encoder_accel_t;
+
+#define RE_ACCEL_BUCKETS 8
+
+/** @brief Per-encoder speed counters, for tuning RE_ACCEL_TABLE */
+typedef struct rotary_encoder_stats {
+  uint32_t detents;          /**< Detents turned */
+  uint32_t steps;            /**< Steps they were worth after acceleration */
+  uint32_t interval_us;      /**< Gap before the last detent in a run */
+  uint32_t interval_us_min;  /**< Shortest gap seen */
+  uint32_t by_row[RE_ACCEL_BUCKETS]; /**< Detents per table row; the row after the last counts single steps */
+} rotary_encoder_stats_t;
+
+void rotary_encoder_init(uint8_t low_pin, uint8_t sm);
+void rotary_encoder_event(context_t *context, const input_event_t *e);
+const rotary_encoder_stats_t *rotary_encoder_stats(uint8_t re);
 
 #ifdef __cplusplus
 }
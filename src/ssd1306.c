@@ -49,18 +49,86 @@ inline static void fancy_write(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src
     }
 }
 
+/* A run of commands can share one control byte (Co=0) and one transaction */
+static void ssd1306_i2c_write_cmds(ssd1306_t *p, const uint8_t *cmds, size_t len) {
+    uint8_t d[len+1];
+    d[0]=0x00;
+    memcpy(d+1, cmds, len);
+    fancy_write(p->i2c_i, p->address, d, len+1, "ssd1306_write_cmds");
+}
+
+/* The byte ahead of the data is borrowed for the data control byte */
+static void ssd1306_i2c_write_data(ssd1306_t *p, uint8_t *data, size_t len) {
+    uint8_t saved=*(data-1);
+    *(data-1)=0x40;
+    fancy_write(p->i2c_i, p->address, data-1, len+1, "ssd1306_write_data");
+    *(data-1)=saved;
+}
+
+const ssd1306_transport_t ssd1306_i2c_transport= {
+    .write_cmds=ssd1306_i2c_write_cmds,
+    .write_data=ssd1306_i2c_write_data,
+};
+
 inline static void ssd1306_write(ssd1306_t *p, uint8_t val) {
-    uint8_t d[2]= {0x00, val};
-    fancy_write(p->i2c_i, p->address, d, 2, "ssd1306_write");
+    p->transport->write_cmds(p, &val, 1);
+}
+
+static bool ssd1306_init_common(ssd1306_t *p, uint16_t width, uint16_t height);
+
+/*
+ * Send columns x0..x1 of `count` logical pages starting at `page`.  Multi-page
+ * spans must be full width and must not wrap around the end of the GDDRAM ring.
+ */
+static void ssd1306_send_span(ssd1306_t *p, uint8_t page, uint8_t count, uint8_t x0, uint8_t x1) {
+    uint8_t ram_page=(page+p->ram_offset)%SSD1306_RAM_PAGES;
+    uint8_t cmds[]= {SET_COL_ADDR, x0, x1, SET_PAGE_ADDR, ram_page, ram_page+count-1};
+    if(p->width==64) {
+        cmds[1]+=32;
+        cmds[2]+=32;
+    }
+    p->transport->write_cmds(p, cmds, sizeof(cmds));
+
+    p->transport->write_data(p, p->buffer+page*p->width+x0, (count-1)*p->width+x1-x0+1);
 }
 
 bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address, i2c_inst_t *i2c_instance) {
+    p->transport=&ssd1306_i2c_transport;
+    p->address=address;
+    p->i2c_i=i2c_instance;
+
+    return ssd1306_init_common(p, width, height);
+}
+
+bool ssd1306_init_spi(ssd1306_t *p, uint16_t width, uint16_t height, spi_inst_t *spi_instance, uint8_t cs_pin, uint8_t dc_pin) {
+    p->transport=&ssd1306_spi_transport;
+    p->spi_i=spi_instance;
+    p->cs_pin=cs_pin;
+    p->dc_pin=dc_pin;
+    ssd1306_spi_transport_init(p);
+
+    return ssd1306_init_common(p, width, height);
+}
+
+bool ssd1306_init_mock(ssd1306_t *p, uint16_t width, uint16_t height, size_t log_size) {
+    p->transport=&ssd1306_mock_transport;
+    if((p->mock_log=pvPortMalloc(log_size))==NULL)
+        return false;
+    p->mock_size=log_size;
+    ssd1306_mock_reset(p);
+
+    if(!ssd1306_init_common(p, width, height)) {
+        vPortFree(p->mock_log);
+        p->mock_log=NULL;
+        return false;
+    }
+    return true;
+}
+
+static bool ssd1306_init_common(ssd1306_t *p, uint16_t width, uint16_t height) {
     p->width=width;
     p->height=height;
     p->pages=height/8;
-    p->address=address;
-
-    p->i2c_i=i2c_instance;
 
 
     p->bufsize=(p->pages)*(p->width);
@@ -71,6 +139,14 @@ bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address
 
     ++(p->buffer);
 
+    if((p->shadow=pvPortMalloc(p->bufsize))==NULL) {
+        vPortFree(p->buffer-1);
+        p->bufsize=0;
+        return false;
+    }
+    p->shadow_valid=0;
+    p->ram_offset=0;
+
     // from https://github.com/makerportal/rpi-pico-ssd1306
     int8_t cmds[]= {
         SET_DISP | 0x00,  // off
@@ -105,14 +181,19 @@ bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address
         SET_DISP | 0x01
     };
 
-    for(size_t i=0; i<sizeof(cmds); ++i)
-        ssd1306_write(p, cmds[i]);
+    p->transport->write_cmds(p, (uint8_t *) cmds, sizeof(cmds));
 
     return true;
 }
 
 inline void ssd1306_deinit(ssd1306_t *p) {
-    free(p->buffer-1);
+    vPortFree(p->buffer-1);
+    vPortFree(p->shadow);
+    if(p->transport==&ssd1306_mock_transport) {
+        vPortFree(p->mock_log);
+        p->mock_log=NULL;
+        p->mock_size=0;
+    }
 }
 
 inline void ssd1306_poweroff(ssd1306_t *p) {
@@ -151,16 +232,62 @@ bool ssd1306_pixel_value(ssd1306_t *p, uint32_t x, uint32_t y) {
 }
 
 void ssd1306_show(ssd1306_t *p) {
-    uint8_t payload[]= {SET_COL_ADDR, 0, p->width-1, SET_PAGE_ADDR, 0, p->pages-1};
-    if(p->width==64) {
-        payload[1]+=32;
-        payload[2]+=32;
+    /* Once scrolled, the logical pages may wrap around the end of the ring */
+    uint8_t first=MIN(p->pages, SSD1306_RAM_PAGES-p->ram_offset);
+    ssd1306_send_span(p, 0, first, 0, p->width-1);
+    if(first<p->pages)
+        ssd1306_send_span(p, first, p->pages-first, 0, p->width-1);
+
+    memcpy(p->shadow, p->buffer, p->bufsize);
+    p->shadow_valid=(1u<<p->pages)-1;
+}
+
+void ssd1306_show_changes(ssd1306_t *p) {
+    for(uint8_t page=0; page<p->pages; ++page) {
+        uint8_t *now=p->buffer+page*p->width;
+        uint8_t *was=p->shadow+page*p->width;
+
+        if(!(p->shadow_valid & (1u<<page))) {
+            ssd1306_send_span(p, page, 1, 0, p->width-1);
+            continue;
+        }
+
+        /* Walk the changed columns, merging runs separated by small gaps */
+        int16_t start=-1, end=-1;
+        for(uint8_t x=0; x<p->width; ++x) {
+            if(now[x]==was[x])
+                continue;
+            if(start>=0 && x-end>SSD1306_SPAN_MERGE_GAP) {
+                ssd1306_send_span(p, page, 1, start, end);
+                start=-1;
+            }
+            if(start<0)
+                start=x;
+            end=x;
+        }
+        if(start>=0)
+            ssd1306_send_span(p, page, 1, start, end);
     }
 
-    for(size_t i=0; i<sizeof(payload); ++i)
-        ssd1306_write(p, payload[i]);
+    memcpy(p->shadow, p->buffer, p->bufsize);
+    p->shadow_valid=(1u<<p->pages)-1;
+}
+
+void ssd1306_scroll(ssd1306_t *p, int8_t pages) {
+    if(!pages)
+        return;
 
-    *(p->buffer-1)=0x40;
+    p->ram_offset=(p->ram_offset+SSD1306_RAM_PAGES+pages%SSD1306_RAM_PAGES)%SSD1306_RAM_PAGES;
+    ssd1306_write(p, SET_DISP_START_LINE | ((p->ram_offset*8) & 0x3F));
 
-    fancy_write(p->i2c_i, p->address, p->buffer-1, p->bufsize+1, "ssd1306_show");
+    /* The pages still on screen moved; the newly exposed ones hold stale GDDRAM */
+    if(pages>=p->pages || -pages>=p->pages) {
+        p->shadow_valid=0;
+    } else if(pages>0) {
+        memmove(p->shadow, p->shadow+pages*p->width, (p->pages-pages)*p->width);
+        p->shadow_valid=(p->shadow_valid>>pages) & ((1u<<(p->pages-pages))-1);
+    } else {
+        memmove(p->shadow-pages*p->width, p->shadow, (p->pages+pages)*p->width);
+        p->shadow_valid=(p->shadow_valid<<-pages) & ((1u<<p->pages)-1);
+    }
 }
@@ -32,6 +32,7 @@ SOFTWARE.
 #define _inc_ssd1306
 #include <pico/stdlib.h>
 #include <hardware/i2c.h>
+#include <hardware/spi.h>
 
 #include "bitmap.h"
 #include "fonts/font.h"
@@ -63,19 +64,56 @@ typedef enum {
     SET_CHARGE_PUMP = 0x8D
 } ssd1306_command_t;
 
+typedef struct ssd1306 ssd1306_t;
+
+/**
+*   @brief moves command and data bytes to the panel
+*/
+typedef struct ssd1306_transport {
+    void (*write_cmds)(ssd1306_t *p, const uint8_t *cmds, size_t len); /**< send a run of commands */
+    void (*write_data)(ssd1306_t *p, uint8_t *data, size_t len); /**< send GDDRAM data; data[-1] may be borrowed */
+} ssd1306_transport_t;
+
+extern const ssd1306_transport_t ssd1306_i2c_transport;
+extern const ssd1306_transport_t ssd1306_spi_transport;
+extern const ssd1306_transport_t ssd1306_mock_transport;
+
 /**
 *   @brief holds the configuration
 */
-typedef struct {
+struct ssd1306 {
     uint8_t width;      /**< width of display */
     uint8_t height; /**< height of display */
     uint8_t pages;      /**< stores pages of display (calculated on initialization*/
+    const ssd1306_transport_t *transport; /**< how bytes get to the panel */
     uint8_t address;    /**< i2c address of display*/
     i2c_inst_t *i2c_i;  /**< i2c connection instance */
+    spi_inst_t *spi_i;  /**< spi connection instance */
+    uint8_t cs_pin;     /**< spi chip select pin (active low) */
+    uint8_t dc_pin;     /**< spi data/command pin (high for data) */
+    uint8_t *mock_log;  /**< mock transport: recorded byte stream */
+    size_t mock_len;    /**< mock transport: bytes recorded */
+    size_t mock_size;   /**< mock transport: capacity of mock_log */
+    uint32_t mock_dropped; /**< mock transport: bytes that did not fit */
     bool external_vcc;  /**< whether display uses external vcc */
     uint8_t *buffer;    /**< display buffer */
     size_t bufsize;     /**< buffer size */
-} ssd1306_t;
+    uint8_t *shadow;    /**< copy of what the panel is showing, in buffer (logical) page order */
+    uint8_t shadow_valid; /**< bitmask of logical pages whose shadow matches the panel */
+    uint8_t ram_offset; /**< GDDRAM page currently shown on the top row (hardware scroll) */
+};
+
+/**
+*   @brief number of pages of GDDRAM on the controller.  Panels shorter than
+*          64 lines only show part of it, the rest is used as scroll-back.
+*/
+#define SSD1306_RAM_PAGES 8
+
+/**
+*   @brief changed runs closer than this many columns are sent as one run.  A
+*          separate run costs about this many bytes of I2C addressing overhead.
+*/
+#define SSD1306_SPAN_MERGE_GAP 8
 
 /**
 *   @brief initialize display
@@ -92,6 +130,55 @@ typedef struct {
 */
 bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address, i2c_inst_t *i2c_instance);
 
+/**
+*   @brief initialize display wired for 4-wire SPI.  The SPI instance and its
+*          SCK/MOSI pins must already be set up; CS and DC are driven here.
+*
+*   @param[in] p : pointer to instance of ssd1306_t
+*   @param[in] width : width of display
+*   @param[in] height : heigth of display
+*   @param[in] spi_instance : instance of spi connection
+*   @param[in] cs_pin : chip select pin
+*   @param[in] dc_pin : data/command pin
+*
+*   @return bool.
+*   @retval true for Success
+*   @retval false if initialization failed
+*/
+bool ssd1306_init_spi(ssd1306_t *p, uint16_t width, uint16_t height, spi_inst_t *spi_instance, uint8_t cs_pin, uint8_t dc_pin);
+
+/**
+*   @brief initialize a display that records the bytes it would have sent
+*          instead of talking to a panel.  Commands are logged behind a 0x00
+*          control byte and data behind 0x40, as they would go over I2C.
+*
+*   @param[in] p : pointer to instance of ssd1306_t
+*   @param[in] width : width of display
+*   @param[in] height : heigth of display
+*   @param[in] log_size : bytes of byte stream to keep
+*
+*   @return bool.
+*   @retval true for Success
+*   @retval false if initialization failed
+*/
+bool ssd1306_init_mock(ssd1306_t *p, uint16_t width, uint16_t height, size_t log_size);
+
+/**
+*   @brief discard the byte stream recorded by the mock transport
+*
+*   @param[in] p : instance of display
+*/
+void ssd1306_mock_reset(ssd1306_t *p);
+
+void ssd1306_spi_transport_init(ssd1306_t *p);
+
+/**
+*   @brief deinit display, freeing its buffers (and the mock log)
+*
+*   @param[in] p : instance of display
+*/
+void ssd1306_deinit(ssd1306_t *p);
+
 /**
 *   @brief turn off display
 *
@@ -134,6 +221,26 @@ void ssd1306_invert(ssd1306_t *p, uint8_t inv);
 */
 void ssd1306_show(ssd1306_t *p);
 
+/**
+    @brief send only the portions of the buffer that differ from what the panel
+           is already showing
+
+    @param[in] p : instance of display
+
+*/
+void ssd1306_show_changes(ssd1306_t *p);
+
+/**
+    @brief scroll the panel contents by whole pages using the display start line.
+           The GDDRAM acts as a ring buffer, so the pages that remain on screen are
+           not re-sent by the next ssd1306_show_changes().
+
+    @param[in] p : instance of display
+    @param[in] pages : pages to scroll, positive moves the contents up
+
+*/
+void ssd1306_scroll(ssd1306_t *p, int8_t pages);
+
 /**
     @brief clear display buffer
 
@@ -155,6 +262,16 @@ bool ssd1306_pixel_value(ssd1306_t *p, uint32_t x, uint32_t y);
 
 void b_ssd1306_init(bitmap_t *b);
 
+/**
+    @brief allocate the framebuffer bitmap for a logical panel
+
+    @param[in] panel : panel number, less than SCREEN_COUNT
+*/
+bitmap_t *b_ssd1306_alloc(uint8_t panel);
+
+uint32_t b_ssd1306_panel_width(uint8_t panel);
+uint32_t b_ssd1306_panel_height(uint8_t panel);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,154 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** @file ssd1306_transport.c
+ *
+ *  @brief SPI and mock transports for the SSD1306 driver.  The I2C transport
+ *         lives with the driver in ssd1306.c.
+ */
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/spi.h"
+
+#include "pcp.h"
+#include "ssd1306.h"
+
+/*  Writes shorter than this are polled out; DMA setup is not worth it  */
+#define SPI_DMA_THRESHOLD 32
+
+/* ---------------------------------------------------------------------- */
+
+/*  One SPI transfer is in flight at a time (the display task's), so the
+ *  channel and the waiting task are shared by all SPI panels.  */
+static int spi_dma_channel = -1;
+static TaskHandle_t spi_dma_waiting_task;
+
+static __isr void s_spi_dma_irq_handler(void)
+{
+    if ( spi_dma_channel < 0 || !dma_channel_get_irq1_status(spi_dma_channel) ) {
+        return;
+    }
+    dma_channel_acknowledge_irq1(spi_dma_channel);
+
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    vTaskNotifyGiveIndexedFromISR(spi_dma_waiting_task, NTFCN_IDX_TRANSFER,
+            &xHigherPriorityTaskWoken
+            );
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+static void s_spi_write(ssd1306_t *p, bool data_p, const uint8_t *src, size_t len)
+{
+    gpio_put(p->dc_pin, data_p);
+    gpio_put(p->cs_pin, 0);
+
+    if (len < SPI_DMA_THRESHOLD) {
+        spi_write_blocking(p->spi_i, src, len);
+    } else {
+        /*  Sleep on the DMA rather than spinning on the FIFO  */
+        spi_dma_waiting_task = xTaskGetCurrentTaskHandle();
+        dma_channel_config c = dma_channel_get_default_config(spi_dma_channel);
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+        channel_config_set_dreq( &c, spi_get_dreq(p->spi_i, true) );
+        dma_channel_configure(spi_dma_channel, &c, &spi_get_hw(p->spi_i)->dr, src, len, true);
+        ulTaskNotifyTakeIndexed(NTFCN_IDX_TRANSFER, pdTRUE, portMAX_DELAY);
+
+        /*  The DMA is done when the last byte is in the FIFO, not on the wire  */
+        while ( spi_is_busy(p->spi_i) ) {
+            ;
+        }
+    }
+
+    gpio_put(p->cs_pin, 1);
+} /* s_spi_write */
+
+static void s_spi_write_cmds(ssd1306_t *p, const uint8_t *cmds, size_t len)
+{
+    s_spi_write(p, false, cmds, len);
+}
+
+static void s_spi_write_data(ssd1306_t *p, uint8_t *data, size_t len)
+{
+    s_spi_write(p, true, data, len);
+}
+
+const ssd1306_transport_t ssd1306_spi_transport = {
+    .write_cmds = s_spi_write_cmds,
+    .write_data = s_spi_write_data,
+};
+
+void ssd1306_spi_transport_init(ssd1306_t *p)
+{
+    gpio_init(p->cs_pin);
+    gpio_set_dir(p->cs_pin, GPIO_OUT);
+    gpio_put(p->cs_pin, 1);
+    gpio_init(p->dc_pin);
+    gpio_set_dir(p->dc_pin, GPIO_OUT);
+
+    if (spi_dma_channel < 0) {
+        spi_dma_channel = dma_claim_unused_channel(true);
+        dma_channel_set_irq1_enabled(spi_dma_channel, true);
+        irq_add_shared_handler(DMA_IRQ_1, s_spi_dma_irq_handler,
+                PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY
+                );
+        irq_set_enabled(DMA_IRQ_1, true);
+    }
+} /* ssd1306_spi_transport_init */
+
+/* ---------------------------------------------------------------------- */
+
+static void s_mock_record(ssd1306_t *p, uint8_t control, const uint8_t *src, size_t len)
+{
+    if (p->mock_len + len + 1 > p->mock_size) {
+        p->mock_dropped += len + 1;
+        return;
+    }
+    p->mock_log[p->mock_len++] = control;
+    memcpy(p->mock_log + p->mock_len, src, len);
+    p->mock_len += len;
+}
+
+static void s_mock_write_cmds(ssd1306_t *p, const uint8_t *cmds, size_t len)
+{
+    s_mock_record(p, 0x00, cmds, len);
+}
+
+static void s_mock_write_data(ssd1306_t *p, uint8_t *data, size_t len)
+{
+    s_mock_record(p, 0x40, data, len);
+}
+
+const ssd1306_transport_t ssd1306_mock_transport = {
+    .write_cmds = s_mock_write_cmds,
+    .write_data = s_mock_write_data,
+};
+
+void ssd1306_mock_reset(ssd1306_t *p)
+{
+    p->mock_len = 0;
+    p->mock_dropped = 0;
+}
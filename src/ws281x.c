@@ -19,94 +19,731 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "pico/stdlib.h"
-#include "pico/sem.h"
 #include "pico/multicore.h"
 
+#include "hardware/dma.h"
+#include "hardware/irq.h"
 #include "hardware/pio.h"
 
 #include "ws2813b.pio.h"
 #include "ws2812.pio.h"
 
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "context.h"
+#include "latency.h"
+#include "led_effect.h"
 #include "log.h"
+#include "ws281x.h"
+#include "ws281x_transpose.h"
 
 #define PIOx __CONCAT(pio, LED_DEVICES_PIO)
 #define GPIO_FUNC_PIOx __CONCAT(GPIO_FUNC_PIO, LED_DEVICES_PIO)
 
-static struct semaphore reset_delay_complete_sem;
-static alarm_id_t reset_delay_alarm_id;
+/*
+ * The DMA is finished when the last pixel is in the FIFO, not on the wire.
+ * Allow for the joined 8-entry FIFO and the output shift register to drain,
+ * 24 bits at no slower than 1.25 µs each, before the reset latch starts.
+ */
+#define WS281X_FIFO_DRAIN_US ( ( 8 + 1 ) * 30 )
+#define WS281X_RESET_LATCH_US 500
+
+/*
+ * Output stage.  Colours are corrected per chain on their way into the frame:
+ * gamma, the global brightness and the diagonal of the white balance matrix
+ * are folded into one table per channel, rebuilt only when one of them
+ * changes, so a pixel costs three lookups.  Only a balance with cross terms
+ * pays for a matrix multiply ahead of the tables.
+ */
+#define WS281X_UNITY 256    /* 1.0 in the Q8 white balance */
+
+typedef struct ws281x_output {
+    uint8_t lut[3][256];    /* R, G and B */
+    int16_t balance[3][3];  /* Q8, rows give R, G and B out */
+    uint16_t scale[3];      /* Brightness times the balance diagonal, of 255 */
+    bool mix;               /* balance has cross terms */
+} ws281x_output_t;
+
+/*  65535 * ( v / 255 ) ^ 2.2  */
+static const uint16_t gamma_16[256] = {
+        0,     0,     2,     4,     7,    11,    17,    24,
+       32,    42,    53,    65,    79,    94,   111,   129,
+      148,   169,   192,   216,   242,   270,   299,   330,
+      362,   396,   432,   469,   508,   549,   591,   635,
+      681,   729,   779,   830,   883,   938,   995,  1053,
+     1113,  1175,  1239,  1305,  1373,  1443,  1514,  1587,
+     1663,  1740,  1819,  1900,  1983,  2068,  2155,  2243,
+     2334,  2427,  2521,  2618,  2717,  2817,  2920,  3024,
+     3131,  3240,  3350,  3463,  3578,  3694,  3813,  3934,
+     4057,  4182,  4309,  4438,  4570,  4703,  4838,  4976,
+     5115,  5257,  5401,  5547,  5695,  5845,  5998,  6152,
+     6309,  6468,  6629,  6792,  6957,  7124,  7294,  7466,
+     7640,  7816,  7994,  8175,  8358,  8543,  8730,  8919,
+     9111,  9305,  9501,  9699,  9900, 10102, 10307, 10515,
+    10724, 10936, 11150, 11366, 11585, 11806, 12029, 12254,
+    12482, 12712, 12944, 13179, 13416, 13655, 13896, 14140,
+    14386, 14635, 14885, 15138, 15394, 15652, 15912, 16174,
+    16439, 16706, 16975, 17247, 17521, 17798, 18077, 18358,
+    18642, 18928, 19216, 19507, 19800, 20095, 20393, 20694,
+    20996, 21301, 21609, 21919, 22231, 22546, 22863, 23182,
+    23504, 23829, 24156, 24485, 24817, 25151, 25487, 25826,
+    26168, 26512, 26858, 27207, 27558, 27912, 28268, 28627,
+    28988, 29351, 29717, 30086, 30457, 30830, 31206, 31585,
+    31966, 32349, 32735, 33124, 33514, 33908, 34304, 34702,
+    35103, 35507, 35913, 36321, 36732, 37146, 37562, 37981,
+    38402, 38825, 39252, 39680, 40112, 40546, 40982, 41421,
+    41862, 42306, 42753, 43202, 43654, 44108, 44565, 45025,
+    45487, 45951, 46418, 46888, 47360, 47835, 48313, 48793,
+    49275, 49761, 50249, 50739, 51232, 51728, 52226, 52727,
+    53230, 53736, 54245, 54756, 55270, 55787, 56306, 56828,
+    57352, 57879, 58409, 58941, 59476, 60014, 60554, 61097,
+    61642, 62190, 62741, 63295, 63851, 64410, 64971, 65535
+};
+
+static uint8_t brightness = LED_BRIGHTNESS;
+
+#define WS281X_IDENTITY_BALANCE { \
+    { WS281X_UNITY, 0, 0 }, \
+    { 0, WS281X_UNITY, 0 }, \
+    { 0, 0, WS281X_UNITY }, \
+}
+#ifndef WS2812_WHITE_BALANCE
+#define WS2812_WHITE_BALANCE WS281X_IDENTITY_BALANCE
+#endif
+#ifndef WS2813B_WHITE_BALANCE
+#define WS2813B_WHITE_BALANCE WS281X_IDENTITY_BALANCE
+#endif
 
-int64_t reset_delay_complete(alarm_id_t id, void *user_date)
+/* In ws281x_chain_id_t order */
+static const int16_t white_balance[][3][3] = {
+    WS2812_WHITE_BALANCE,
+    WS2813B_WHITE_BALANCE,
+};
+
+static void ws281x_output_build(ws281x_output_t *out)
 {
-    reset_delay_alarm_id = 0;
-    sem_release(&reset_delay_complete_sem);
-    return 0;
+    out->mix = false;
+    for (uint8_t c = 0; c < 3; c++) {
+        for (uint8_t j = 0; j < 3; j++) {
+            out->mix |= ( j != c ) && out->balance[c][j];
+        }
+    }
+
+    for (uint8_t c = 0; c < 3; c++) {
+        /*  When mixing, the whole matrix, diagonal included, runs ahead of the tables  */
+        int32_t diagonal = out->mix ? WS281X_UNITY : MIN(MAX(out->balance[c][c], 0), 2 * WS281X_UNITY);
+        uint32_t scale = brightness * diagonal / WS281X_UNITY;
+        out->scale[c] = scale;
+        for (uint16_t v = 0; v < 256; v++) {
+            out->lut[c][v] = MIN( ( gamma_16[v] * scale + 32767u ) / 65535u, 255u );
+        }
+    }
+}
+
+static inline uint8_t ws281x_output_mix(const ws281x_output_t *out, uint8_t c,
+        uint8_t r, uint8_t g, uint8_t b)
+{
+    int32_t v = out->balance[c][0] * r + out->balance[c][1] * g + out->balance[c][2] * b;
+    return MIN(MAX( ( v + WS281X_UNITY / 2 ) / WS281X_UNITY, 0 ), 255);
 }
 
 /*
  * The LED expects GRB (not RGB like the rest of the world.
  */
-static inline uint32_t urgb_u32(uint32_t rgb)
+static inline uint32_t ws281x_output_grb(const ws281x_output_t *out, uint32_t rgb)
+{
+    uint8_t r = rgb >> 16, g = rgb >> 8, b = rgb;
+
+    if (out->mix) {
+        uint8_t r_in = r, g_in = g, b_in = b;
+        r = ws281x_output_mix(out, 0, r_in, g_in, b_in);
+        g = ws281x_output_mix(out, 1, r_in, g_in, b_in);
+        b = ws281x_output_mix(out, 2, r_in, g_in, b_in);
+    }
+    return ( out->lut[1][g] << 16 ) | ( out->lut[0][r] << 8 ) | out->lut[2][b];
+}
+
+#ifdef WS281X_DITHER
+#if LED_FRAME_RATE < 200
+#error "WS281X_DITHER needs LED_FRAME_RATE of 200 or more, or the dither flickers"
+#endif
+
+/*
+ * Temporal dithering.  The output stage is worked in 16 bits, 8.8 of an
+ * output step, without the tables, and each refresh emits the integer part
+ * plus whatever fraction has built up in the residual.  Residuals are kept
+ * per palette entry, not per LED, so long strips cost nothing extra.
+ * Returns GRB and sets *fraction if the colour needs dithering at all.
+ */
+static inline uint32_t ws281x_output_grb_dither(const ws281x_output_t *out, uint32_t rgb,
+        uint8_t residual[3], bool *fraction)
+{
+    uint8_t v[3] = { rgb >> 16, rgb >> 8, rgb };
+    uint32_t grb = 0;
+
+    if (out->mix) {
+        uint8_t r_in = v[0], g_in = v[1], b_in = v[2];
+        for (uint8_t c = 0; c < 3; c++) {
+            v[c] = ws281x_output_mix(out, c, r_in, g_in, b_in);
+        }
+    }
+    for (uint8_t c = 0; c < 3; c++) {
+        uint32_t v16 = MIN(gamma_16[v[c]] * out->scale[c] / 255u, 0xFFFFu);
+        uint32_t sum = v16 + residual[c];
+        uint8_t v8 = MIN(sum >> 8, 255u);
+        residual[c] = v8 == 255u ? 0 : sum & 0xFF;
+        *fraction |= ( v16 & 0xFF ) != 0;
+        grb |= v8 << ( c == 1 ? 16 : c == 0 ? 8 : 0 );
+    }
+    return grb;
+}
+#endif /* WS281X_DITHER */
+
+/*
+ * Chains and ports.  A chain is a strip of LEDs as drawn:  its frames are a
+ * palette index per LED, so a long strip costs two bytes per LED (the frame
+ * being sent and the one being drawn) rather than eight.  Callers draw into
+ * the pending frame and post it, overwriting anything not yet sent.
+ *
+ * A port is a state machine and a DMA channel carrying one chain or, with the
+ * ws2812_parallel program, up to eight chains on consecutive pins at once.
+ * Once a port has latched, the LED task swaps its chains' posted frames in
+ * and runs their palettes through the output stage;  the frames are
+ * then expanded a chunk at a time while the DMA sends the chunk before.  Each
+ * port latches on its own, so ports never wait on each other.
+ */
+#define WS281X_BITS_PER_LED 24
+#define WS281X_CHUNK 48          /* LEDs per chunk, serial port:  a word each */
+#define WS281X_PARALLEL_CHUNK ( WS281X_CHUNK * 4 / WS281X_BITS_PER_LED )  /* A byte per bit */
+#define WS281X_MAX_LANES 8
+
+typedef struct ws281x_port ws281x_port_t;
+
+typedef struct ws281x_chain {
+    uint8_t *index;         /* Frame being sent */
+    uint8_t *pending;       /* Frame being drawn, and posted */
+    uint16_t count;
+    ws281x_port_t *port;
+    volatile bool posted;   /* pending holds a frame that has not been sent */
+    volatile bool drawing;  /* Between ws281x_frame_begin() and ws281x_show() */
+    volatile bool stale;    /* Swapped out;  pending is a frame behind index */
+    volatile bool resend;   /* Send index again, as it is */
+    bool dithering;         /* The frame being sent has colours between output steps */
+    uint8_t residual[WS281X_PALETTE_SIZE][3];      /* Dithering error, R, G and B */
+    uint32_t palette[WS281X_PALETTE_SIZE];         /* RGB, for the frame being sent */
+    uint32_t pending_palette[WS281X_PALETTE_SIZE];
+    uint32_t grb_palette[WS281X_PALETTE_SIZE];     /* GRB, through the output stage */
+    uint16_t uses[WS281X_PALETTE_SIZE];            /* LEDs on each entry in the frame being sent */
+    uint32_t load;          /* Channel values times their full-on mA, summed over the frame being sent, before limiting */
+    ws281x_output_t out;
+} ws281x_chain_t;
+
+struct ws281x_port {
+    uint sm;
+    int dma_channel;
+    ws281x_chain_t *lanes[WS281X_MAX_LANES];  /* Lane n is on the port's first pin + n */
+    uint8_t lane_count;
+    uint16_t count;         /* LEDs on the longest lane */
+    volatile bool latching; /* Sending, or holding the line for the reset latch */
+    void ( *expand )(ws281x_port_t *, uint8_t c);
+    uint32_t chunks[2][WS281X_CHUNK];
+    uint16_t chunk_len[2];  /* DMA transfers in each chunk */
+    uint8_t chunk;          /* Chunk being sent */
+    uint16_t expanded;      /* LEDs expanded into chunks so far */
+};
+
+static uint8_t ws2812_index[2][WS2812_PIXEL_COUNT];
+static uint8_t ws2813b_index[2][WS2813B_PIXEL_COUNT];
+
+static ws281x_chain_t chains[] = {
+    { ws2812_index[0], ws2812_index[1], WS2812_PIXEL_COUNT },
+    { ws2813b_index[0], ws2813b_index[1], WS2813B_PIXEL_COUNT },
+};
+
+#define WS281X_CHAIN_COUNT ( sizeof( chains ) / sizeof( chains[0] ) )
+
+#ifdef WS281X_PARALLEL
+#if PICO_WS2813B_PIN != PICO_WS2812_PIN + 1
+#error "WS281X_PARALLEL needs the chains on consecutive pins, WS2812 first"
+#endif
+static ws281x_port_t ports[1];
+#else
+static ws281x_port_t ports[WS281X_CHAIN_COUNT];
+#endif
+
+#define WS281X_PORT_COUNT ( sizeof( ports ) / sizeof( ports[0] ) )
+
+/*
+ * Where each key of a keyboard strip is.  A map can be supplied at build time
+ * as a file of { first, count } initializers, otherwise the keys share the
+ * strip evenly.
+ */
+#ifdef STRIP_KEY_COUNT
+typedef struct {
+    uint16_t first;
+    uint16_t count;
+} ws281x_segment_t;
+
+#ifdef STRIP_KEY_MAP_FILE
+static const ws281x_segment_t strip_key_map[STRIP_KEY_COUNT] = {
+#include STRIP_KEY_MAP_FILE
+};
+#define STRIP_KEY_SEGMENT(k) ( strip_key_map[k] )
+#else
+#define STRIP_KEY_SEGMENT(k) ( (ws281x_segment_t) { \
+        ( k ) * WS2813B_PIXEL_COUNT / STRIP_KEY_COUNT, \
+        ( ( k ) + 1 ) * WS2813B_PIXEL_COUNT / STRIP_KEY_COUNT - ( k ) * WS2813B_PIXEL_COUNT / STRIP_KEY_COUNT \
+    } )
+#endif
+#endif /* STRIP_KEY_COUNT */
+
+/* ---------------------------------------------------------------------- */
+
+static inline void ws281x_port_wake(ws281x_port_t *port)
+{
+    if (tasks.leds) {
+        xTaskNotifyIndexed(tasks.leds, NTFCN_IDX_EVENT, 1u << ( port - ports ), eSetBits);
+    }
+}
+
+/*  Expand the next run of a one-lane port into a chunk of GRB words, as shifted out  */
+static void ws281x_port_expand_serial(ws281x_port_t *port, uint8_t c)
+{
+    ws281x_chain_t *chain = port->lanes[0];
+    uint16_t n = MIN(port->count - port->expanded, WS281X_CHUNK);
+    const uint8_t *index = &chain->index[port->expanded];
+    uint32_t *grb = port->chunks[c];
+
+    for (uint16_t i = 0; i < n; i++) {
+        grb[i] = chain->grb_palette[index[i] & ( WS281X_PALETTE_SIZE - 1 )] << 8u;
+    }
+    port->chunk_len[c] = n;
+    port->expanded += n;
+}
+
+/*
+ * Expand the next run of a parallel port into bit planes:  a byte per bit
+ * time, one bit per lane.  The DMA writes them a byte at a time and the bus
+ * replicates each across the FIFO word, so ws2812_parallel's `out x, 32`
+ * sees the lanes in its low bits.  Lanes shorter than the port send zeros.
+ */
+static void ws281x_port_expand_parallel(ws281x_port_t *port, uint8_t c)
+{
+    uint16_t n = MIN(port->count - port->expanded, WS281X_PARALLEL_CHUNK);
+    uint8_t *planes = (uint8_t *) port->chunks[c];
+
+    for (uint16_t i = 0; i < n; i++) {
+        uint16_t led = port->expanded + i;
+        uint8_t g[WS281X_MAX_LANES] = { 0 }, r[WS281X_MAX_LANES] = { 0 }, b[WS281X_MAX_LANES] = { 0 };
+        for (uint8_t l = 0; l < port->lane_count; l++) {
+            ws281x_chain_t *chain = port->lanes[l];
+            if (led < chain->count) {
+                uint32_t grb = chain->grb_palette[chain->index[led] & ( WS281X_PALETTE_SIZE - 1 )];
+                uint8_t m = WS281X_MAX_LANES - 1 - l;
+                g[m] = grb >> 16;
+                r[m] = grb >> 8;
+                b[m] = grb;
+            }
+        }
+        ws281x_transpose8(g, planes);
+        ws281x_transpose8(r, planes + 8);
+        ws281x_transpose8(b, planes + 16);
+        planes += WS281X_BITS_PER_LED;
+    }
+    port->chunk_len[c] = n * WS281X_BITS_PER_LED;
+    port->expanded += n;
+}
+
+static inline void ws281x_port_send_chunk(ws281x_port_t *port, uint8_t c)
+{
+    port->chunk = c;
+    dma_channel_transfer_from_buffer_now(port->dma_channel, port->chunks[c], port->chunk_len[c]);
+}
+
+int64_t reset_delay_complete(alarm_id_t id, void *user_data)
+{
+    ws281x_port_t *port = (ws281x_port_t *) user_data;
+    BaseType_t higher_priority_task_woken = pdFALSE;
+
+    port->latching = false;
+    latency_frame_end_from_isr(LATENCY_OUTPUT_LEDS + ( port - ports ), LATENCY_LEDS + ( port - ports ));
+    xTaskNotifyIndexedFromISR(tasks.leds, NTFCN_IDX_EVENT, 1u << ( port - ports ),
+            eSetBits, &higher_priority_task_woken
+            );
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+    return 0;
+}
+
+/*
+ * A chunk is in the FIFO.  Start the other one, which is already expanded,
+ * and expand the next run into this one.  The FIFO covers the gap on a serial
+ * port;  on a parallel port it holds only a few bit times, but a late start
+ * just stretches a low period, which the LEDs ignore well short of the reset
+ * time.  After the last chunk, wait for the FIFO to drain and hold the line
+ * low for the reset latch before the port sends another frame.
+ */
+static void __isr ws281x_dma_irq_handler(void)
+{
+    for (uint8_t i = 0; i < WS281X_PORT_COUNT; i++) {
+        ws281x_port_t *port = &ports[i];
+        if ( port->dma_channel < 0 || !dma_channel_get_irq0_status(port->dma_channel) ) {
+            continue;
+        }
+        dma_channel_acknowledge_irq0(port->dma_channel);
+
+        uint8_t c = port->chunk;
+        if (port->chunk_len[c ^ 1]) {
+            ws281x_port_send_chunk(port, c ^ 1);
+            port->expand(port, c);
+        } else {
+            add_alarm_in_us(WS281X_FIFO_DRAIN_US + WS281X_RESET_LATCH_US,
+                    reset_delay_complete, port, true
+                    );
+        }
+    }
+}
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Drawing.  A frame is drawn with ws281x_frame_begin(), any of the drawing
+ * calls and ws281x_show().  Until it is shown the LED task leaves the pending
+ * frame alone, and it keeps its contents from one frame to the next.
+ */
+void ws281x_frame_begin(ws281x_chain_id_t id)
 {
-    return ( ( rgb & 0xff0000 ) >> 8 ) |
-           ( ( rgb & 0x00ff00 ) << 8 ) |
-           ( rgb & 0x0000ff );
+    ws281x_chain_t *chain = &chains[id];
+
+    taskENTER_CRITICAL();
+    chain->posted = false;
+    chain->drawing = true;
+    bool stale = chain->stale;
+    chain->stale = false;
+    taskEXIT_CRITICAL();
+
+    /*  The frame last shown went out with the swap;  draw on from it.  The LED
+     *  task leaves index alone until this frame is shown.  */
+    if (stale) {
+        memcpy(chain->pending, chain->index, chain->count);
+    }
 }
 
-static inline void ws2813b_put_pixel(uint32_t pixel_grb)
+void ws281x_set_palette(ws281x_chain_id_t id, uint8_t index, uint32_t rgb)
 {
-    pio_sm_put_blocking(PIOx, PICO_WS2813B_SM, pixel_grb << 8u);
+    assert(index < WS281X_PALETTE_SIZE);
+    chains[id].pending_palette[index] = rgb;
 }
 
-static inline void ws2812_put_pixel(uint32_t pixel_grb)
+void ws281x_fill(ws281x_chain_id_t id, uint16_t first, uint16_t count, uint8_t index)
 {
-    pio_sm_put_blocking(PIOx, PICO_WS2812_SM, pixel_grb << 8u);
+    ws281x_chain_t *chain = &chains[id];
+    if (first < chain->count) {
+        memset(&chain->pending[first], index, MIN(count, chain->count - first));
+    }
+}
+
+void ws281x_show(ws281x_chain_id_t id)
+{
+    chains[id].drawing = false;
+    chains[id].posted = true;
+    ws281x_port_wake(chains[id].port);
 }
 
 void ws2812_put_pixels(uint32_t **rgbs, uint8_t size)
 {
-    sem_acquire_blocking(&reset_delay_complete_sem);
-    for (uint8_t i = 0; i<size; i++) {ws2812_put_pixel( urgb_u32(*rgbs[i]) );}
-    if (reset_delay_alarm_id) {
-        cancel_alarm(reset_delay_alarm_id);
+    ws281x_frame_begin(WS281X_CHAIN_WS2812);
+    for (uint8_t i = 0; i<WS2812_PIXEL_COUNT; i++) {
+        ws281x_set_palette(WS281X_CHAIN_WS2812, i, i < size ? *rgbs[i] : 0u);
+        ws281x_fill(WS281X_CHAIN_WS2812, i, 1, i);
     }
-    reset_delay_alarm_id = add_alarm_in_us(500, reset_delay_complete, NULL, true);
+    ws281x_show(WS281X_CHAIN_WS2812);
 }
 
 void ws2813b_sparkle_pixels(uint32_t **rgbs_ptr, uint8_t size)
 {
-    static uint32_t rgbs[WS2813B_PIXEL_COUNT], grbs[WS2813B_PIXEL_COUNT];
-
+    uint32_t rgbs[WS281X_PALETTE_SIZE];
     uint8_t count = 0;
 
-    for (uint8_t i = 0; i<size; i++) {
+    ws281x_frame_begin(WS281X_CHAIN_WS2813B);
+    for (uint8_t i = 0; i<size && count<WS281X_PALETTE_SIZE; i++) {
         uint8_t j;
         for (j = 0; j<count; j++) {
             if (*rgbs_ptr[i] == rgbs[j]) {
                 break;
             }
         }
-        if (j>=i) {
+        if (j>=count) {
             rgbs[count] = *rgbs_ptr[i];
-            grbs[count] = urgb_u32(*rgbs_ptr[i]);
+            ws281x_set_palette(WS281X_CHAIN_WS2813B, count, rgbs[count]);
             count++;
         }
     }
 
-    sem_acquire_blocking(&reset_delay_complete_sem);
-    for (uint8_t i = 0; i<WS2813B_PIXEL_COUNT; i++) {ws2813b_put_pixel(grbs[i % count]);}
-    if (reset_delay_alarm_id) {
-        cancel_alarm(reset_delay_alarm_id);
+    for (uint16_t i = 0; i<WS2813B_PIXEL_COUNT; i++) {
+        ws281x_fill(WS281X_CHAIN_WS2813B, i, 1, count ? i % count : 0);
     }
-    reset_delay_alarm_id = add_alarm_in_us(500, reset_delay_complete, NULL, true);
+    ws281x_show(WS281X_CHAIN_WS2813B);
 } /* ws2813b_sparkle_pixels */
 
+#ifdef STRIP_KEY_COUNT
+/*
+ * Light every key of the strip whose note is one of notes[], in that note's
+ * colour.  Palette entry 0 is off and entry i + 1 is rgbs[i].
+ */
+void ws2813b_key_pixels(uint32_t **rgbs, const int8_t *notes, uint8_t size)
+{
+    ws281x_frame_begin(WS281X_CHAIN_WS2813B);
+    ws281x_set_palette(WS281X_CHAIN_WS2813B, 0, 0u);
+    for (uint8_t i = 0; i<size && i + 1<WS281X_PALETTE_SIZE; i++) {
+        ws281x_set_palette(WS281X_CHAIN_WS2813B, i + 1, *rgbs[i]);
+    }
+
+    for (uint16_t k = 0; k<STRIP_KEY_COUNT; k++) {
+        int8_t note = ( k + STRIP_FIRST_NOTE ) % STRIP_NOTES_PER_OCTAVE;
+        uint8_t index = 0;
+        for (uint8_t i = 0; i<size && i + 1<WS281X_PALETTE_SIZE; i++) {
+            if (notes[i] == note) {
+                index = i + 1;
+                break;
+            }
+        }
+        ws281x_segment_t segment = STRIP_KEY_SEGMENT(k);
+        ws281x_fill(WS281X_CHAIN_WS2813B, segment.first, segment.count, index);
+    }
+    ws281x_show(WS281X_CHAIN_WS2813B);
+} /* ws2813b_key_pixels */
+#endif /* STRIP_KEY_COUNT */
+
+static void ws281x_chain_output_update(ws281x_chain_id_t chain)
+{
+    ws281x_output_t out;
+
+    memcpy(out.balance, white_balance[chain], sizeof( out.balance ));
+    ws281x_output_build(&out);
+    taskENTER_CRITICAL();
+    chains[chain].out = out;
+    taskEXIT_CRITICAL();
+}
+
+/*  A still frame is not posted again, so it is sent again as it is  */
+void ws281x_set_brightness(uint8_t b)
+{
+    brightness = b;
+    for (uint8_t i = 0; i < WS281X_CHAIN_COUNT; i++) {
+        ws281x_chain_output_update(i);
+        chains[i].resend = true;
+    }
+    for (uint8_t i = 0; i < WS281X_PORT_COUNT; i++) {
+        ws281x_port_wake(&ports[i]);
+    }
+}
+
+uint8_t ws281x_brightness()
+{
+    return brightness;
+}
+
+/*
+ * Power limiting.  A frame's draw is estimated from the channel values
+ * actually shifted out:  the palette, through the output stage, weighted by
+ * the LEDs on each entry, counted as the frame is copied for sending.  When
+ * every chain together would go over LED_POWER_BUDGET_MA, the palettes are
+ * scaled down, at once, and let back up a little each frame after.
+ */
+#define WS281X_LIMIT_RELEASE 16    /* Frames to close most of the way back */
+
+static ws281x_power_stats_t power_stats = {
+    .budget_ma = LED_POWER_BUDGET_MA,
+    .scale = 0x100,
+};
+
+static inline uint32_t ws281x_load_ma(uint32_t load)
+{
+    return load / 255;
+}
+
+/*  Red, green and blue dies draw different currents;  grb is as sent  */
+static inline uint32_t ws281x_grb_load(uint32_t grb)
+{
+    return ( grb >> 16 ) * LED_MA_GREEN + ( ( grb >> 8 ) & 0xFF ) * LED_MA_RED +
+           ( grb & 0xFF ) * LED_MA_BLUE;
+}
+
+static void ws281x_port_limit(ws281x_port_t *port)
+{
+    uint32_t idle_ma = 0, load_ma = 0;
+
+    for (uint8_t l = 0; l < port->lane_count; l++) {
+        ws281x_chain_t *chain = port->lanes[l];
+        chain->load = 0;
+        for (uint8_t p = 0; p < WS281X_PALETTE_SIZE; p++) {
+            chain->load += chain->uses[p] * ws281x_grb_load(chain->grb_palette[p]);
+        }
+    }
+    for (uint8_t i = 0; i < WS281X_CHAIN_COUNT; i++) {
+        idle_ma += chains[i].count * LED_IDLE_MA;
+        load_ma += ws281x_load_ma(chains[i].load);
+    }
+
+    uint16_t target = 0x100;
+    if (idle_ma + load_ma > power_stats.budget_ma) {
+        target = power_stats.budget_ma > idle_ma ?
+            ( power_stats.budget_ma - idle_ma ) * 0x100 / load_ma : 0;
+    }
+    uint16_t scale = power_stats.scale;
+    if (target < scale) {
+        scale = target;
+    } else {
+        scale += ( target - scale + WS281X_LIMIT_RELEASE - 1 ) / WS281X_LIMIT_RELEASE;
+    }
+
+    power_stats.scale = scale;
+    power_stats.estimate_ma = idle_ma + load_ma;
+    power_stats.drawn_ma = idle_ma + ( load_ma * scale >> 8 );
+    power_stats.drawn_ma_max = MAX(power_stats.drawn_ma_max, power_stats.drawn_ma);
+    if (scale < 0x100) {
+        power_stats.limited_frames++;
+        for (uint8_t l = 0; l < port->lane_count; l++) {
+            ws281x_chain_t *chain = port->lanes[l];
+            for (uint8_t p = 0; p < WS281X_PALETTE_SIZE; p++) {
+                uint32_t grb = chain->grb_palette[p];
+                chain->grb_palette[p] = ( ( ( grb >> 16 ) * scale >> 8 ) << 16 ) |
+                                        ( ( ( ( grb >> 8 ) & 0xFF ) * scale >> 8 ) << 8 ) |
+                                        ( ( grb & 0xFF ) * scale >> 8 );
+            }
+        }
+    }
+} /* ws281x_port_limit */
+
+const ws281x_power_stats_t *ws281x_power_stats()
+{
+    return &power_stats;
+}
+
+/*
+ * Sends the latest frames posted to each port, as soon as the port has
+ * latched the one before.
+ */
+void ws281x_task(void *parm)
+{
+    for ( ;;) {
+        uint32_t bits = 0u;
+        xTaskNotifyWaitIndexed(NTFCN_IDX_EVENT, 0u, 0xFFFFFFFFu, &bits, portMAX_DELAY);
+        if (bits & WS281X_TICK_BIT) {
+            led_effect_tick();
+#ifdef WS281X_DITHER
+            /*  A dithered frame has to be sent again every tick to average out  */
+            for (uint8_t i = 0; i < WS281X_CHAIN_COUNT; i++) {
+                ws281x_chain_t *chain = &chains[i];
+                if (chain->dithering) {
+                    chain->resend = true;
+                }
+            }
+#endif
+        }
+
+        for (uint8_t i = 0; i < WS281X_PORT_COUNT; i++) {
+            ws281x_port_t *port = &ports[i];
+
+            /*  Only pointer swaps and the palette copy happen with interrupts masked  */
+            uint8_t swapped = 0;
+            taskENTER_CRITICAL();
+            bool send = false;
+            if (!port->latching) {
+                for (uint8_t l = 0; l < port->lane_count; l++) {
+                    ws281x_chain_t *chain = port->lanes[l];
+                    if (chain->posted) {
+                        uint8_t *sent = chain->index;
+                        chain->index = chain->pending;
+                        chain->pending = sent;
+                        memcpy(chain->palette, chain->pending_palette, sizeof( chain->palette ));
+                        chain->posted = false;
+                        chain->stale = true;
+                        swapped |= 1u << l;
+                    }
+                    send |= chain->resend || ( swapped & ( 1u << l ) );
+                    chain->resend = false;
+                }
+                port->latching = send;
+            }
+            taskEXIT_CRITICAL();
+
+            if (send) {
+                latency_frame_begin(LATENCY_OUTPUT_LEDS + i);
+                for (uint8_t l = 0; l < port->lane_count; l++) {
+                    ws281x_chain_t *chain = port->lanes[l];
+                    if (swapped & ( 1u << l )) {
+                        memset(chain->uses, 0, sizeof( chain->uses ));
+                        for (uint16_t j = 0; j < chain->count; j++) {
+                            chain->index[j] &= WS281X_PALETTE_SIZE - 1;
+                            chain->uses[chain->index[j]]++;
+                        }
+                    }
+#ifdef WS281X_DITHER
+                    chain->dithering = false;
+                    for (uint8_t p = 0; p < WS281X_PALETTE_SIZE; p++) {
+                        chain->grb_palette[p] = ws281x_output_grb_dither(&chain->out,
+                                chain->palette[p], chain->residual[p], &chain->dithering
+                                );
+                    }
+#else
+                    for (uint8_t p = 0; p < WS281X_PALETTE_SIZE; p++) {
+                        chain->grb_palette[p] = ws281x_output_grb(&chain->out, chain->palette[p]);
+                    }
+#endif
+                }
+                ws281x_port_limit(port);
+                port->expanded = 0;
+                port->expand(port, 0);
+                port->expand(port, 1);
+                ws281x_port_send_chunk(port, 0);
+            }
+        }
+    }
+} /* ws281x_task */
+
+static void ws281x_port_init(ws281x_port_t *port, uint sm, enum dma_channel_transfer_size size,
+        void ( *expand )(ws281x_port_t *, uint8_t))
+{
+    port->sm = sm;
+    port->expand = expand;
+    port->count = 0;
+    for (uint8_t l = 0; l < port->lane_count; l++) {
+        port->lanes[l]->port = port;
+        port->count = MAX(port->count, port->lanes[l]->count);
+    }
+
+    port->dma_channel = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(port->dma_channel);
+    channel_config_set_transfer_data_size(&c, size);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq( &c, pio_get_dreq(PIOx, sm, true) );
+    dma_channel_configure(port->dma_channel, &c, &PIOx->txf[sm], port->chunks[0], 0, false);
+    dma_channel_set_irq0_enabled(port->dma_channel, true);
+}
+
 /*
  * Output WS2813B_PIXEL_COUNT pixels of a given color
  */
 void ws281x_pio_init()
 {
+#ifdef WS281X_PARALLEL
+    /*  Every chain on one state machine, lane n on PICO_WS2812_PIN + n  */
+    pio_sm_claim(PIOx, PICO_WS2812_SM);
+    uint parallel_offset = pio_add_program(PIOx, &ws2812_parallel_program);
+    ws2812_parallel_program_init(PIOx, PICO_WS2812_SM, parallel_offset, PICO_WS2812_PIN,
+            WS281X_CHAIN_COUNT, 800000
+            );
+    for (uint8_t i = 0; i < WS281X_CHAIN_COUNT; i++) {
+        ports[0].lanes[ports[0].lane_count++] = &chains[i];
+    }
+    ws281x_port_init(&ports[0], PICO_WS2812_SM, DMA_SIZE_8, ws281x_port_expand_parallel);
+#else
     gpio_set_function(PICO_WS2813B_PIN, GPIO_FUNC_PIOx);
     pio_sm_claim(PIOx, PICO_WS2813B_PIN);
     uint ws2813b_offset = pio_add_program(PIOx, &ws2813b_program);
@@ -117,5 +754,23 @@ void ws281x_pio_init()
     uint ws2812_offset = pio_add_program(PIOx, &ws2812_program);
     ws2812_program_init(PIOx, PICO_WS2812_SM, ws2812_offset, PICO_WS2812_PIN, false);
 
-    sem_init(&reset_delay_complete_sem, 1, 1);
+    ports[WS281X_CHAIN_WS2812].lanes[0] = &chains[WS281X_CHAIN_WS2812];
+    ports[WS281X_CHAIN_WS2812].lane_count = 1;
+    ws281x_port_init(&ports[WS281X_CHAIN_WS2812], PICO_WS2812_SM, DMA_SIZE_32,
+            ws281x_port_expand_serial
+            );
+    ports[WS281X_CHAIN_WS2813B].lanes[0] = &chains[WS281X_CHAIN_WS2813B];
+    ports[WS281X_CHAIN_WS2813B].lane_count = 1;
+    ws281x_port_init(&ports[WS281X_CHAIN_WS2813B], PICO_WS2813B_SM, DMA_SIZE_32,
+            ws281x_port_expand_serial
+            );
+#endif
+
+    for (uint8_t i = 0; i < WS281X_CHAIN_COUNT; i++) {
+        ws281x_chain_output_update(i);
+    }
+    irq_add_shared_handler(DMA_IRQ_0, ws281x_dma_irq_handler,
+            PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY
+            );
+    irq_set_enabled(DMA_IRQ_0, true);
 } /* ws281x_pio_init */
@@ -31,9 +31,52 @@
 extern "C" {
 #endif
 
+typedef enum {
+    WS281X_CHAIN_WS2812,
+    WS281X_CHAIN_WS2813B,
+} ws281x_chain_id_t;
+
+#define WS281X_PALETTE_SIZE 16  /* A power of two */
+#define WS281X_TICK_BIT ( 1u << 31 )  /* LED task notification:  animation tick */
+
+#ifndef STRIP_FIRST_NOTE
+#define STRIP_FIRST_NOTE 9  /* The note of key 0, counting from C:  A0 on a full keyboard */
+#endif
+#define STRIP_NOTES_PER_OCTAVE 12
+
+extern void ws281x_frame_begin(ws281x_chain_id_t chain);
+extern void ws281x_set_palette(ws281x_chain_id_t chain, uint8_t index, uint32_t rgb);
+extern void ws281x_fill(ws281x_chain_id_t chain, uint16_t first, uint16_t count, uint8_t index);
+extern void ws281x_show(ws281x_chain_id_t chain);
+
 extern void ws2812_put_pixels(uint32_t **rgbs, uint8_t size);
 extern void ws2813b_sparkle_pixels(uint32_t **rgbs, uint8_t size);
+#ifdef STRIP_KEY_COUNT
+extern void ws2813b_key_pixels(uint32_t **rgbs, const int8_t *notes, uint8_t size);
+#endif
 extern void ws281x_pio_init();
+extern void ws281x_task(void *parm);
+
+/*
+ * Brightness applies to every chain.  White balance is fixed per chain at
+ * build time, WS2812_WHITE_BALANCE and WS2813B_WHITE_BALANCE.
+ */
+extern void ws281x_set_brightness(uint8_t brightness);
+extern uint8_t ws281x_brightness();
+
+/*
+ * Estimated current of the LEDs, every chain together, as of the last frame sent
+ */
+typedef struct ws281x_power_stats {
+    uint32_t budget_ma;
+    uint32_t estimate_ma;     /* What the last frame would have drawn unlimited */
+    uint32_t drawn_ma;        /* What it draws as limited */
+    uint32_t drawn_ma_max;
+    uint16_t scale;           /* Limiter, 8.8:  0x100 is not limiting */
+    uint32_t limited_frames;  /* Frames sent scaled down */
+} ws281x_power_stats_t;
+
+extern const ws281x_power_stats_t *ws281x_power_stats();
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,63 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __WS281X_TRANSPOSE_H
+#define __WS281X_TRANSPOSE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @file ws281x_transpose.h
+ *
+ *  @brief The bit-plane kernel of the parallel LED output.  It needs nothing
+ *         from the SDK, so the host tests build it as it is.
+ */
+
+/*
+ * 8x8 bit matrix transpose (Hacker's Delight, 7-3).  in[] holds one byte per
+ * lane, last lane first;  out[n] has bit n of every lane's byte, MSB first,
+ * with lane m in bit m.
+ */
+static inline void ws281x_transpose8(const uint8_t *in, uint8_t *out)
+{
+    uint32_t x = ( (uint32_t) in[0] << 24 ) | ( in[1] << 16 ) | ( in[2] << 8 ) | in[3];
+    uint32_t y = ( (uint32_t) in[4] << 24 ) | ( in[5] << 16 ) | ( in[6] << 8 ) | in[7];
+    uint32_t t;
+
+    t = ( x ^ ( x >> 7 ) ) & 0x00AA00AAu;  x = x ^ t ^ ( t << 7 );
+    t = ( y ^ ( y >> 7 ) ) & 0x00AA00AAu;  y = y ^ t ^ ( t << 7 );
+    t = ( x ^ ( x >> 14 ) ) & 0x0000CCCCu; x = x ^ t ^ ( t << 14 );
+    t = ( y ^ ( y >> 14 ) ) & 0x0000CCCCu; y = y ^ t ^ ( t << 14 );
+    t = ( x & 0xF0F0F0F0u ) | ( ( y >> 4 ) & 0x0F0F0F0Fu );
+    y = ( ( x << 4 ) & 0xF0F0F0F0u ) | ( y & 0x0F0F0F0Fu );
+    x = t;
+
+    out[0] = x >> 24; out[1] = x >> 16; out[2] = x >> 8; out[3] = x;
+    out[4] = y >> 24; out[5] = y >> 16; out[6] = y >> 8; out[7] = y;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __WS281X_TRANSPOSE_H */
@@ -0,0 +1,158 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** @file bitmap_pbm_test.c
+ *
+ *  The PBM screen backend:  a panel drawn the way a context's display
+ *  callback draws it (clear, labels, a swatch, show) is written out as a PBM
+ *  image that matches the buffer pixel for pixel.  Moving the swatch by one
+ *  column changes exactly the bytes it should, and the transport stats and
+ *  the CSV agree.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "bitmap.h"
+#include "bitmap_pbm.h"
+#include "ssd1306.h"
+
+#define SWATCH_Y 8
+#define SWATCH_SIZE 10
+#define SPAN_BYTES( columns ) ( 7 + 1 + ( columns ) )  /*  Addressing, control byte, data  */
+
+static void s_render(bitmap_t *b, uint32_t swatch_x)
+{
+    bitmap_clear(b);
+    bitmap_draw_string(b, 0, 24, &spleen_5x8, "Red");
+    bitmap_draw_string(b, 40, 24, &spleen_5x8, "Green");
+    bitmap_draw_string(b, 80, 24, &spleen_5x8, "Blue");
+    bitmap_draw_square(b, swatch_x, SWATCH_Y, SWATCH_SIZE, SWATCH_SIZE);
+    bitmap_show(b);
+}
+
+/*  Every pixel of the PBM matches the bitmap;  a set bit is an unlit pixel  */
+static void s_check_pbm(bitmap_t *b, uint32_t frame)
+{
+    char name[256];
+    snprintf(name, sizeof( name ), "%spanel0-%06lu.pbm", SCREEN_PBM, (unsigned long) frame);
+    FILE *f = fopen(name, "rb");
+    TEST_CHECK(f, "no %s", name);
+    if (!f) {
+        return;
+    }
+
+    unsigned long width = 0, height = 0;
+    TEST_CHECK(fscanf(f, "P4 %lu %lu", &width, &height) == 2 && fgetc(f) == '\n',
+            "%s: bad header", name
+            );
+    TEST_CHECK(width == b->width && height == b->height, "%s is %lux%lu", name, width, height);
+
+    uint8_t row[( SCREEN_WIDTH + 7 ) / 8];
+    uint32_t mismatches = 0;
+    for (uint32_t y = 0; y < b->height; y++) {
+        TEST_CHECK(fread(row, 1, sizeof( row ), f) == sizeof( row ), "%s: short at row %u", name, y);
+        for (uint32_t x = 0; x < b->width; x++) {
+            bool unlit = row[x >> 3] & ( 0x80u >> ( x & 7u ) );
+            mismatches += unlit == bitmap_pixel_value(b, x, y);
+        }
+    }
+    TEST_CHECK(fgetc(f) == EOF, "%s: trailing bytes", name);
+    TEST_CHECK(mismatches == 0, "%s: %u pixels differ from the bitmap", name, mismatches);
+    fclose(f);
+}
+
+static uint32_t s_lit_bytes(bitmap_t *b)
+{
+    ssd1306_t *disp = (ssd1306_t *) b->buffer;
+    uint32_t lit = 0;
+    for (size_t i = 0; i < disp->bufsize; i++) {
+        lit += disp->buffer[i] != 0;
+    }
+    return lit;
+}
+
+int main()
+{
+    bitmap_t *b = b_ssd1306_alloc(0);
+    const pbm_stats_t *stats = b_pbm_stats(0);
+
+    /*  The first frame:  every lit byte changed, and every page is sent whole  */
+    s_render(b, 100);
+    s_check_pbm(b, 0);
+    TEST_CHECK(stats->frames == 1, "%lu frames", (unsigned long) stats->frames);
+    TEST_CHECK(stats->changed_bytes == s_lit_bytes(b), "first frame changed %lu bytes, %lu lit",
+            (unsigned long) stats->changed_bytes, (unsigned long) s_lit_bytes(b)
+            );
+    TEST_CHECK(stats->sent_bytes == 4 * SPAN_BYTES(SCREEN_WIDTH), "first frame sent %lu bytes",
+            (unsigned long) stats->sent_bytes
+            );
+    TEST_CHECK(!bitmap_pixel_value(b, 99, SWATCH_Y) && bitmap_pixel_value(b, 100, SWATCH_Y),
+            "swatch not at 100"
+            );
+
+    /*  One column right:  columns 100 and 110 change, on the two pages the
+     *  swatch covers, and they are too far apart to merge  */
+    s_render(b, 101);
+    s_check_pbm(b, 1);
+    TEST_CHECK(stats->changed_bytes == 4, "moved swatch changed %lu bytes",
+            (unsigned long) stats->changed_bytes
+            );
+    TEST_CHECK(stats->sent_bytes == 4 * SPAN_BYTES(1), "moved swatch sent %lu bytes",
+            (unsigned long) stats->sent_bytes
+            );
+
+    /*  Drawn again the same:  nothing changed, nothing sent  */
+    s_render(b, 101);
+    s_check_pbm(b, 2);
+    TEST_CHECK(stats->changed_bytes == 0 && stats->sent_bytes == 0,
+            "redraw changed %lu, sent %lu bytes", (unsigned long) stats->changed_bytes,
+            (unsigned long) stats->sent_bytes
+            );
+    TEST_CHECK(stats->frames == 3, "%lu frames", (unsigned long) stats->frames);
+
+    /*  The CSV has a line per frame with the same numbers  */
+    FILE *csv = fopen(SCREEN_PBM "panel0.csv", "r");
+    TEST_CHECK(csv, "no CSV");
+    if (csv) {
+        char line[128];
+        const unsigned long want[][2] = {
+            { 0, 0 }, { 4, 4 * SPAN_BYTES(1) }, { 0, 0 },
+        };
+        TEST_CHECK(fgets(line, sizeof( line ), csv)
+                && strcmp(line, "frame,time_us,render_us,changed_bytes,sent_bytes\n") == 0,
+                "CSV header %s", line
+                );
+        for (unsigned long i = 0; i < 3; i++) {
+            unsigned long frame, time_us, render_us, changed, sent;
+            TEST_CHECK(fscanf(csv, "%lu,%lu,%lu,%lu,%lu\n", &frame, &time_us, &render_us,
+                    &changed, &sent
+                    ) == 5, "CSV line %lu", i
+                    );
+            TEST_CHECK(frame == i, "CSV frame %lu, wanted %lu", frame, i);
+            TEST_CHECK(i == 0 || ( changed == want[i][0] && sent == want[i][1] ),
+                    "CSV frame %lu: changed %lu, sent %lu", i, changed, sent
+                    );
+        }
+        fclose(csv);
+    }
+
+    return test_result();
+}
@@ -0,0 +1,168 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** @file gesture_wheel_test.c
+ *
+ *  The gesture timer wheel:  deadlines fire on their tick and only then,
+ *  re-arming and cancelling leave nothing behind, the tick count wraps, and
+ *  a wheel that fell behind catches up.  Then random arms and cancels against
+ *  a plain list of deadlines.
+ */
+
+#include <stdlib.h>
+
+#include "test.h"
+#include "gesture_wheel.h"
+
+#define MODEL_TICKS 2000000u
+
+/*  Turn up to now, collecting what fired at each tick  */
+static uint32_t s_turn_to(gesture_wheel_t *w, uint32_t now, uint32_t fired[], uint32_t first)
+{
+    uint32_t all = 0;
+    while ( gesture_wheel_due(w, now) ) {
+        uint32_t due = gesture_wheel_turn(w);
+        if (fired) {
+            fired[w->processed - first] = due;
+        }
+        all |= due;
+    }
+    return all;
+}
+
+static void s_check_deadlines()
+{
+    gesture_wheel_t w = { 0 };
+
+    TEST_CHECK(!gesture_wheel_due(&w, 5), "idle wheel is due");
+
+    gesture_wheel_arm(&w, 0, 0, 5);
+    gesture_wheel_arm(&w, 3, 0, 1);
+    gesture_wheel_arm(&w, 31, 0, GESTURE_WHEEL_SLOTS - 1);
+    for (uint32_t t = 1; t < GESTURE_WHEEL_SLOTS; t++) {
+        uint32_t want = ( t == 1 ? 1u << 3 : 0 ) | ( t == 5 ? 1u << 0 : 0 ) |
+                ( t == GESTURE_WHEEL_SLOTS - 1 ? 1u << 31 : 0 );
+        uint32_t got = s_turn_to(&w, t, NULL, 0);
+        TEST_CHECK(got == want, "tick %u fired %08x, wanted %08x", t, got, want);
+    }
+    TEST_CHECK(!w.armed && !gesture_wheel_due(&w, 1000), "armed %08x after the lap", w.armed);
+}
+
+static void s_check_rearm_cancel()
+{
+    gesture_wheel_t w = { 0 };
+    uint32_t fired[64] = { 0 };
+
+    /*  Pressed again before its deadline:  the old bit stays in its slot  */
+    gesture_wheel_arm(&w, 1, 0, 10);
+    s_turn_to(&w, 3, fired, 0);
+    gesture_wheel_arm(&w, 1, 3, 20);
+    gesture_wheel_arm(&w, 2, 3, 4);
+    gesture_wheel_cancel(&w, 1u << 2);
+    s_turn_to(&w, 40, fired, 0);
+    for (uint32_t t = 1; t <= 40; t++) {
+        uint32_t want = t == 23 ? 1u << 1 : 0;
+        TEST_CHECK(fired[t] == want, "tick %u fired %08x, wanted %08x", t, fired[t], want);
+    }
+
+    /*  Cancelled to idle, the stale bits must not fire a later deadline early  */
+    gesture_wheel_arm(&w, 4, 40, 6);
+    gesture_wheel_cancel(&w, 1u << 4);
+    TEST_CHECK(!gesture_wheel_due(&w, 50), "cancelled wheel is due");
+    gesture_wheel_arm(&w, 4, 100, 14);
+    uint32_t early = s_turn_to(&w, 113, NULL, 0);
+    TEST_CHECK(early == 0, "fired %08x before the deadline", early);
+    TEST_CHECK(s_turn_to(&w, 114, NULL, 0) == 1u << 4, "missed the deadline");
+}
+
+static void s_check_wrap()
+{
+    gesture_wheel_t w = { 0 };
+    uint32_t now = UINT32_MAX - 5;
+
+    gesture_wheel_arm(&w, 7, now, 20);
+    TEST_CHECK(s_turn_to(&w, 13, NULL, 0) == 0, "fired before the wrapped deadline");
+    TEST_CHECK(s_turn_to(&w, 14, NULL, 0) == 1u << 7, "missed the wrapped deadline");
+}
+
+/*  The input task was busy:  everything past comes out of one advance  */
+static void s_check_catch_up()
+{
+    gesture_wheel_t w = { 0 };
+
+    for (uint8_t b = 0; b < GESTURE_WHEEL_BUTTONS; b++) {
+        gesture_wheel_arm(&w, b, 0, 1 + b * 3);
+    }
+    TEST_CHECK(s_turn_to(&w, 50, NULL, 0) == 0x0001ffffu, "first catch up");
+    TEST_CHECK(s_turn_to(&w, 200, NULL, 0) == 0xfffe0000u, "second catch up");
+}
+
+/* ---------------------------------------------------------------------- */
+
+/*  One random arm, re-arm or cancel a tick against plain deadlines  */
+static void s_check_model()
+{
+    gesture_wheel_t w = { 0 };
+    uint32_t deadline[GESTURE_WHEEL_BUTTONS];
+    uint32_t armed = 0, fired = 0;
+    uint32_t now = UINT32_MAX - MODEL_TICKS / 2;
+
+    srand(2022);
+    uint64_t start = test_now_ns();
+    for (uint32_t i = 0; i < MODEL_TICKS && test_failures < 10; i++) {
+        uint8_t b = rand() % GESTURE_WHEEL_BUTTONS;
+        if (rand() % 4) {
+            uint32_t ticks = 1 + rand() % ( GESTURE_WHEEL_SLOTS - 1 );
+            gesture_wheel_arm(&w, b, now, ticks);
+            deadline[b] = now + ticks;
+            armed |= 1u << b;
+        } else {
+            gesture_wheel_cancel(&w, 1u << b);
+            armed &= ~( 1u << b );
+        }
+
+        now++;
+        uint32_t want = 0;
+        for (uint32_t m = armed; m; m &= m - 1) {
+            uint8_t d = __builtin_ctz(m);
+            if (deadline[d] == now) {
+                want |= 1u << d;
+            }
+        }
+        armed &= ~want;
+        uint32_t got = s_turn_to(&w, now, NULL, 0);
+        TEST_CHECK(got == want, "tick %u fired %08x, wanted %08x", now, got, want);
+        TEST_CHECK(w.armed == armed, "tick %u armed %08x, wanted %08x", now, w.armed, armed);
+        fired += __builtin_popcount(got);
+    }
+    double ns = (double) ( test_now_ns() - start ) / MODEL_TICKS;
+    printf("model:  %u ticks, %u deadlines fired, %.1f ns per tick\n", MODEL_TICKS, fired, ns);
+}
+
+int main()
+{
+    s_check_deadlines();
+    s_check_rearm_cancel();
+    s_check_wrap();
+    s_check_catch_up();
+    s_check_model();
+
+    return test_result();
+}
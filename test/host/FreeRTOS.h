@@ -0,0 +1,47 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HOST_FREERTOS_H
+#define __HOST_FREERTOS_H
+
+/** @file FreeRTOS.h
+ *
+ *  @brief Host stand-ins for the FreeRTOS the firmware sources under test
+ *         touch.  The heap is the C library's; nothing ever blocks.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE ( (BaseType_t) 0 )
+#define pdTRUE  ( (BaseType_t) 1 )
+#define pdPASS  pdTRUE
+#define portMAX_DELAY ( (TickType_t) 0xffffffffu )
+#define pdMS_TO_TICKS( ms ) ( (TickType_t) ( ms ) )
+#define portYIELD_FROM_ISR( x ) ( (void) ( x ) )
+
+#define pvPortMalloc malloc
+#define vPortFree free
+
+#endif /* __HOST_FREERTOS_H */
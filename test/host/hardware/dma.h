@@ -0,0 +1,90 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HOST_HARDWARE_DMA_H
+#define __HOST_HARDWARE_DMA_H
+
+/** @file dma.h
+ *
+ *  @brief Host stand-ins:  channels can be claimed and configured, and no
+ *         transfer ever starts.
+ */
+
+#include "pico/stdlib.h"
+#include "hardware/irq.h"
+
+typedef enum dma_channel_transfer_size {
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2,
+} dma_channel_transfer_size_t;
+
+typedef struct {
+    uint32_t ctrl;
+} dma_channel_config;
+
+static inline int dma_claim_unused_channel(bool required)
+{
+    (void) required;
+    return 0;
+}
+
+static inline dma_channel_config dma_channel_get_default_config(uint channel)
+{
+    (void) channel;
+    return (dma_channel_config) { 0 };
+}
+
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c,
+        dma_channel_transfer_size_t size)
+{
+    (void) c, (void) size;
+}
+
+static inline void channel_config_set_dreq(dma_channel_config *c, uint dreq)
+{
+    (void) c, (void) dreq;
+}
+
+static inline void dma_channel_configure(uint channel, const dma_channel_config *config,
+        volatile void *write_addr, const volatile void *read_addr, uint transfer_count,
+        bool trigger)
+{
+    (void) channel, (void) config, (void) write_addr, (void) read_addr;
+    (void) transfer_count, (void) trigger;
+}
+
+static inline void dma_channel_set_irq1_enabled(uint channel, bool enabled)
+{
+    (void) channel, (void) enabled;
+}
+
+static inline bool dma_channel_get_irq1_status(uint channel)
+{
+    (void) channel;
+    return false;
+}
+
+static inline void dma_channel_acknowledge_irq1(uint channel)
+{
+    (void) channel;
+}
+
+#endif /* __HOST_HARDWARE_DMA_H */
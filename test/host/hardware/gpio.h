@@ -0,0 +1,48 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HOST_HARDWARE_GPIO_H
+#define __HOST_HARDWARE_GPIO_H
+
+/** @file gpio.h
+ *
+ *  @brief Host stand-ins:  the pins go nowhere.
+ */
+
+#include "pico/stdlib.h"
+
+#define GPIO_OUT true
+
+static inline void gpio_init(uint gpio)
+{
+    (void) gpio;
+}
+
+static inline void gpio_set_dir(uint gpio, bool out)
+{
+    (void) gpio, (void) out;
+}
+
+static inline void gpio_put(uint gpio, bool value)
+{
+    (void) gpio, (void) value;
+}
+
+#endif /* __HOST_HARDWARE_GPIO_H */
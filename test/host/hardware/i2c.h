@@ -0,0 +1,40 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HOST_HARDWARE_I2C_H
+#define __HOST_HARDWARE_I2C_H
+
+/** @file i2c.h
+ *
+ *  @brief Host stand-in:  no device ever acknowledges.
+ */
+
+#include "pico/stdlib.h"
+
+typedef struct i2c_inst i2c_inst_t;
+
+static inline int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src,
+        size_t len, bool nostop)
+{
+    (void) i2c, (void) addr, (void) src, (void) len, (void) nostop;
+    return PICO_ERROR_GENERIC;
+}
+
+#endif /* __HOST_HARDWARE_I2C_H */
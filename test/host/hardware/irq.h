@@ -0,0 +1,50 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HOST_HARDWARE_IRQ_H
+#define __HOST_HARDWARE_IRQ_H
+
+/** @file irq.h
+ *
+ *  @brief Host stand-ins:  handlers are accepted and never run.
+ */
+
+#include "pico/stdlib.h"
+
+typedef void (*irq_handler_t)(void);
+
+enum {
+    DMA_IRQ_0 = 11,
+    DMA_IRQ_1 = 12,
+};
+
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+
+static inline void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t priority)
+{
+    (void) num, (void) handler, (void) priority;
+}
+
+static inline void irq_set_enabled(uint num, bool enabled)
+{
+    (void) num, (void) enabled;
+}
+
+#endif /* __HOST_HARDWARE_IRQ_H */
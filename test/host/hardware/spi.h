@@ -0,0 +1,62 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HOST_HARDWARE_SPI_H
+#define __HOST_HARDWARE_SPI_H
+
+/** @file spi.h
+ *
+ *  @brief Host stand-ins:  writes vanish and the bus is never busy.
+ */
+
+#include "pico/stdlib.h"
+
+typedef struct spi_hw {
+    volatile uint32_t dr;
+} spi_hw_t;
+
+typedef struct spi_inst spi_inst_t;
+
+static inline spi_hw_t *spi_get_hw(spi_inst_t *spi)
+{
+    static spi_hw_t hw;
+    (void) spi;
+    return &hw;
+}
+
+static inline uint spi_get_dreq(spi_inst_t *spi, bool is_tx)
+{
+    (void) spi, (void) is_tx;
+    return 0;
+}
+
+static inline int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len)
+{
+    (void) spi, (void) src;
+    return (int) len;
+}
+
+static inline bool spi_is_busy(spi_inst_t *spi)
+{
+    (void) spi;
+    return false;
+}
+
+#endif /* __HOST_HARDWARE_SPI_H */
@@ -0,0 +1,69 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HOST_PICO_STDLIB_H
+#define __HOST_PICO_STDLIB_H
+
+/** @file stdlib.h
+ *
+ *  @brief Host stand-ins for the parts of pico/stdlib.h the firmware sources
+ *         under test use.  time_us_32() is the host's monotonic clock.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef unsigned int uint;
+
+#define __isr
+#define __not_in_flash_func( f ) f
+
+#ifndef MIN
+#define MIN( a, b ) ( ( a ) < ( b ) ? ( a ) : ( b ) )
+#endif
+#ifndef MAX
+#define MAX( a, b ) ( ( a ) > ( b ) ? ( a ) : ( b ) )
+#endif
+
+enum {
+    PICO_OK = 0,
+    PICO_ERROR_GENERIC = -1,
+    PICO_ERROR_TIMEOUT = -2,
+};
+
+static inline uint32_t time_us_32(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t) ( (uint64_t) ts.tv_sec * 1000000u + ts.tv_nsec / 1000 );
+}
+
+#define panic( ... ) do { \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        abort(); \
+} while (0)
+
+#endif /* __HOST_PICO_STDLIB_H */
@@ -0,0 +1,34 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HOST_SEMPHR_H
+#define __HOST_SEMPHR_H
+
+/** @file semphr.h
+ *
+ *  @brief Host stand-in:  only the handle types are needed so far.
+ */
+
+#include "FreeRTOS.h"
+
+typedef void *SemaphoreHandle_t;
+typedef void *QueueHandle_t;
+
+#endif /* __HOST_SEMPHR_H */
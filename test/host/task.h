@@ -0,0 +1,61 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HOST_TASK_H
+#define __HOST_TASK_H
+
+/** @file task.h
+ *
+ *  @brief Host stand-ins for task handles and notifications:  one task, and
+ *         every notification has already arrived.
+ */
+
+#include "FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+static inline TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return NULL;
+}
+
+static inline uint32_t ulTaskNotifyTakeIndexed(UBaseType_t index, BaseType_t clear, TickType_t wait)
+{
+    (void) index, (void) clear, (void) wait;
+    return 1;
+}
+
+static inline BaseType_t xTaskNotifyGiveIndexed(TaskHandle_t task, UBaseType_t index)
+{
+    (void) task, (void) index;
+    return pdPASS;
+}
+
+static inline void vTaskNotifyGiveIndexedFromISR(TaskHandle_t task, UBaseType_t index,
+        BaseType_t *woken)
+{
+    (void) task, (void) index;
+    *woken = pdFALSE;
+}
+
+#endif /* __HOST_TASK_H */
@@ -0,0 +1,123 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** @file hsv_test.c
+ *
+ *  Round-trips every RGB colour through hsv_from_rgb() and hsv_to_rgb(),
+ *  reports the worst channel error, then times both conversions.
+ */
+
+#include <stdlib.h>
+
+#include "test.h"
+#include "hsv.h"
+
+/*  Hue truncates to 1/256 of a sector and saturation to 8 bits, and p, q
+ *  and t round again on the way back:  a handful of colours come back off by 3  */
+#define HSV_ROUND_TRIP_MAX_ERROR 3
+
+#define BENCH_COLORS 4096
+#define BENCH_ROUNDS 2000
+
+static int32_t s_channel_error(uint32_t a, uint32_t b)
+{
+    int32_t worst = 0;
+    for (uint8_t shift = 0; shift < 24; shift += 8) {
+        int32_t e = abs( (int32_t) ( ( a >> shift ) & 0xFF ) - (int32_t) ( ( b >> shift ) & 0xFF ) );
+        worst = e > worst ? e : worst;
+    }
+    return worst;
+}
+
+static void s_check()
+{
+    uint32_t histogram[256] = { 0 };
+    uint32_t worst_rgb = 0;
+    int32_t worst = 0;
+
+    for (uint32_t rgb = 0; rgb < 0x1000000; rgb++) {
+        uint16_t h = 0;
+        uint8_t s, v;
+        hsv_from_rgb(rgb, &h, &s, &v);
+        TEST_CHECK(h < HUE_RANGE, "rgb %06x hue %u", rgb, h);
+        int32_t e = s_channel_error(rgb, hsv_to_rgb(h, s, v));
+        histogram[e]++;
+        if (e > worst) {
+            worst = e;
+            worst_rgb = rgb;
+        }
+    }
+    printf("round trip, colours off by:");
+    for (int32_t e = 0; e <= worst; e++) {
+        printf("  %d: %u", e, histogram[e]);
+    }
+    printf("\n");
+    TEST_CHECK(worst <= HSV_ROUND_TRIP_MAX_ERROR, "rgb %06x is off by %d", worst_rgb, worst);
+
+    /*  The sector corners are exact  */
+    TEST_CHECK(hsv_to_rgb(0, 255, 255) == 0xFF0000, "red");
+    TEST_CHECK(hsv_to_rgb(2 * HUE_SECTOR, 255, 255) == 0x00FF00, "green");
+    TEST_CHECK(hsv_to_rgb(4 * HUE_SECTOR, 255, 255) == 0x0000FF, "blue");
+    TEST_CHECK(hsv_to_rgb(123, 0, 77) == 0x4D4D4D, "grey");
+}
+
+static void s_bench()
+{
+    static uint32_t rgbs[BENCH_COLORS];
+    static uint16_t hs[BENCH_COLORS];
+    static uint8_t ss[BENCH_COLORS], vs[BENCH_COLORS];
+
+    srand(1);
+    for (uint32_t i = 0; i < BENCH_COLORS; i++) {
+        rgbs[i] = rand() & 0xFFFFFF;
+        hs[i] = rand() % HUE_RANGE;
+        ss[i] = rand();
+        vs[i] = rand();
+    }
+
+    uint64_t start = test_now_ns();
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+        for (uint32_t i = 0; i < BENCH_COLORS; i++) {
+            test_sink += hsv_to_rgb(hs[i], ss[i], vs[i]);
+        }
+    }
+    double to_rgb = (double) ( test_now_ns() - start ) / ( (double) BENCH_ROUNDS * BENCH_COLORS );
+
+    start = test_now_ns();
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+        for (uint32_t i = 0; i < BENCH_COLORS; i++) {
+            uint16_t h = 0;
+            uint8_t s, v;
+            hsv_from_rgb(rgbs[i], &h, &s, &v);
+            test_sink += h + s + v;
+        }
+    }
+    double from_rgb = (double) ( test_now_ns() - start ) / ( (double) BENCH_ROUNDS * BENCH_COLORS );
+
+    printf("ns per conversion:  hsv_to_rgb %.1f  hsv_from_rgb %.1f\n", to_rgb, from_rgb);
+}
+
+int main()
+{
+    s_check();
+    s_bench();
+
+    return test_result();
+}
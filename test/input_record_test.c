@@ -0,0 +1,205 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** @file input_record_test.c
+ *
+ *  Input recordings survive a trip through text:  record events, dump them,
+ *  load the dump back, and the second dump matches the first and a replay
+ *  gives back the events recorded.  Then the ring keeping only the newest
+ *  records, and the loader turning away bad dumps.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "context.h"
+#include "input_record.h"
+#include "log.h"
+
+task_list_t tasks;  /*  No input task to wake  */
+
+#define ROUND_TRIP_EVENTS 40
+#define LINE_LENGTH 128
+
+/*  Dump to a temporary file and read it back whole  */
+static char *s_dump()
+{
+    FILE *f = tmpfile();
+    input_record_dump(f);
+    long size = ftell(f);
+    rewind(f);
+    char *text = calloc(size + 1, 1);
+    TEST_CHECK(fread(text, 1, size, f) == (size_t) size, "short read of the dump");
+    fclose(f);
+    return text;
+}
+
+/*  Feed text to the loader a line at a time, as the console does  */
+static input_load_t s_load(const char *text)
+{
+    char line[LINE_LENGTH];
+    input_load_t status = INPUT_LOAD_MORE;
+
+    input_load_start();
+    while (*text && status == INPUT_LOAD_MORE) {
+        size_t len = strcspn(text, "\n");
+        TEST_CHECK(len < sizeof( line ), "line of %zu characters", len);
+        if (len >= sizeof( line )) {
+            return INPUT_LOAD_ERROR;
+        }
+        memcpy(line, text, len);
+        line[len] = '\0';
+        status = input_load_line(line);
+        text += len + ( text[len] == '\n' );
+    }
+    return status;
+}
+
+/*  Encoders and buttons, a burst, a pause too long for one record and a tie  */
+static void s_record(input_event_t *events, uint32_t count)
+{
+    input_record_start();
+    uint32_t t = time_us_32();
+    for (uint32_t i = 0; i < count; i++) {
+        t += i == count / 2 ? 5000000 : ( i % 5 ) * INPUT_RECORD_US * 37;
+        events[i] = (input_event_t) {
+            .time_us = t,
+            .source = i % 3 ? INPUT_ENCODER : INPUT_BUTTON,
+            .device = i % 3 ? i % RE_COUNT : i % BUTTON_COUNT,
+            .value = i % 3 ? ( i & 1 ? -1 : 1 ) : ( i / 3 ) & 1,
+        };
+        input_record_event(&events[i]);
+    }
+    input_record_stop();
+}
+
+static void s_check_round_trip()
+{
+    input_event_t events[ROUND_TRIP_EVENTS];
+
+    s_record(events, ROUND_TRIP_EVENTS);
+    uint32_t count = input_record_count();
+    TEST_CHECK(count == ROUND_TRIP_EVENTS + 1, "%lu records, wanted a gap record too",
+            (unsigned long) count
+            );
+    char *first = s_dump();
+
+    TEST_CHECK(s_load(first) == INPUT_LOAD_DONE, "load");
+    TEST_CHECK(input_record_count() == count, "loaded %lu records of %lu",
+            (unsigned long) input_record_count(), (unsigned long) count
+            );
+    char *second = s_dump();
+    TEST_CHECK(strcmp(first, second) == 0, "dumps differ:\n%s\n%s", first, second);
+
+    /*  Fast enough that the five-second pause passes in 20ms  */
+    input_replay_start(255);
+    uint32_t replayed = 0, start = time_us_32();
+    input_event_t e;
+    while (replayed < ROUND_TRIP_EVENTS && time_us_32() - start < 1000000) {
+        if ( !input_replay_next(&e) ) {
+            continue;
+        }
+        input_event_t *want = &events[replayed++];
+        TEST_CHECK(e.source == want->source && e.device == want->device &&
+                e.value == want->value, "event %lu came back as %u/%u/%d, wanted %u/%u/%d",
+                (unsigned long) replayed - 1, e.source, e.device, e.value, want->source,
+                want->device, want->value
+                );
+    }
+    TEST_CHECK(replayed == ROUND_TRIP_EVENTS, "replayed %lu events", (unsigned long) replayed);
+    TEST_CHECK(!input_replay_next(&e), "replayed past the end");
+
+    free(first);
+    free(second);
+}
+
+/*  Only the newest records are dumped, and they load back the same  */
+static void s_check_ring()
+{
+    input_event_t events[INPUT_RECORD_EVENTS + 10];
+
+    s_record(events, INPUT_RECORD_EVENTS + 10);
+    TEST_CHECK(input_record_count() == INPUT_RECORD_EVENTS, "%lu records kept",
+            (unsigned long) input_record_count()
+            );
+    char *first = s_dump();
+    TEST_CHECK(s_load(first) == INPUT_LOAD_DONE, "load a full ring");
+    char *second = s_dump();
+    TEST_CHECK(strcmp(first, second) == 0, "full ring dumps differ");
+    free(first);
+    free(second);
+}
+
+static void s_check_bad_dumps()
+{
+    static const struct {
+        const char *text;
+        input_load_t want;
+    } cases[] = {
+        { "Recording\nStopped with 2 records\nREC 2\n00010105 0002817f\nEND\n", INPUT_LOAD_DONE },
+        { "REC 0\nEND\n", INPUT_LOAD_DONE },
+        { "REC 2\n00010105 0002817f\n\nEND\n", INPUT_LOAD_DONE },
+        { "REC 3\n00010105 0002817f\nEND\n", INPUT_LOAD_ERROR },
+        { "REC 1\n00010105 0002817f\nEND\n", INPUT_LOAD_ERROR },
+        { "REC 2\n00010105 002817f\nEND\n", INPUT_LOAD_ERROR },
+        { "REC 2\n00010105 0002817fx\nEND\n", INPUT_LOAD_ERROR },
+        { "REC two\nEND\n", INPUT_LOAD_ERROR },
+        { "REC 100000\nEND\n", INPUT_LOAD_ERROR },
+        { "REC 2\n00010105\n", INPUT_LOAD_MORE },
+    };
+
+    for (uint32_t i = 0; i < sizeof( cases ) / sizeof( cases[0] ); i++) {
+        input_load_t got = s_load(cases[i].text);
+        TEST_CHECK(got == cases[i].want, "case %lu loaded %d, wanted %d",
+                (unsigned long) i, got, cases[i].want
+                );
+        if (got == INPUT_LOAD_ERROR) {
+            TEST_CHECK(input_record_count() == 0, "case %lu left %lu records", (unsigned long) i,
+                    (unsigned long) input_record_count()
+                    );
+        }
+    }
+    input_load_abort();
+    TEST_CHECK(input_record_count() == 0, "abort left %lu records",
+            (unsigned long) input_record_count()
+            );
+
+    /*  The records themselves:  delta, button bit and device, signed value  */
+    TEST_CHECK(s_load("REC 1\n12348305\nEND\n") == INPUT_LOAD_DONE, "load one");
+    input_replay_start(255);
+    input_event_t e;
+    uint32_t start = time_us_32();
+    while ( !input_replay_next(&e) && time_us_32() - start < 1000000 ) {
+        ;
+    }
+    TEST_CHECK(e.source == INPUT_BUTTON && e.device == 3 && e.value == 5, "got %u/%u/%d",
+            e.source, e.device, e.value
+            );
+}
+
+int main()
+{
+    log_set_quiet(true);
+    s_check_round_trip();
+    s_check_ring();
+    s_check_bad_dumps();
+
+    return test_result();
+}
@@ -0,0 +1,180 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** @file input_ring_test.c
+ *
+ *  The input event ring:  order, wrap of the free-running indices, overflow
+ *  and high-water accounting, then a producer thread pushing encoder bursts
+ *  as fast as it can at a consumer that drains the ring as the input task
+ *  does.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+
+#define INPUT_RING_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#include "test.h"
+#include "input_ring.h"
+
+#define STRESS_EVENTS 2000000u
+#define STRESS_BURST  48  /*  A fast spin of every encoder at once  */
+
+static void s_check_order()
+{
+    input_ring_t r = { 0 };
+    input_event_t e = { 0 };
+
+    TEST_CHECK(input_ring_empty(&r), "new ring is not empty");
+    TEST_CHECK(!input_ring_pop(&r, &e), "popped from an empty ring");
+
+    for (uint32_t i = 0; i < 5; i++) {
+        TEST_CHECK(input_ring_push(&r, i, INPUT_ENCODER, i, i & 1 ? -1 : 1), "push %u", i);
+    }
+    for (uint32_t i = 0; i < 5; i++) {
+        TEST_CHECK(input_ring_pop(&r, &e), "pop %u", i);
+        TEST_CHECK(e.time_us == i && e.device == i && e.value == ( i & 1 ? -1 : 1 ),
+                "event %u came back as %u/%u/%d", i, e.time_us, e.device, e.value
+                );
+    }
+    TEST_CHECK(input_ring_empty(&r), "ring not empty after draining");
+    TEST_CHECK(r.high_water == 5, "high water %u", r.high_water);
+}
+
+/*  The indices run free:  start just short of the wrap and go through it  */
+static void s_check_wrap()
+{
+    input_ring_t r = { .head = UINT32_MAX - 3, .tail = UINT32_MAX - 3 };
+    input_event_t e = { 0 };
+
+    for (uint32_t i = 0; i < 3 * INPUT_RING_SIZE; i++) {
+        TEST_CHECK(input_ring_push(&r, i, INPUT_BUTTON, 0, 1), "push %u at head %u", i, r.head);
+        if (i % 3 == 2) {
+            for (uint32_t j = i - 2; j <= i; j++) {
+                TEST_CHECK(input_ring_pop(&r, &e) && e.time_us == j, "pop %u got %u", j, e.time_us);
+            }
+        }
+    }
+    TEST_CHECK(input_ring_empty(&r), "ring not empty after wrap");
+    TEST_CHECK(r.high_water == 3, "high water %u", r.high_water);
+    TEST_CHECK(r.overflows == 0, "overflows %u", r.overflows);
+}
+
+static void s_check_overflow()
+{
+    input_ring_t r = { .head = UINT32_MAX - 1, .tail = UINT32_MAX - 1 };
+    input_event_t e = { 0 };
+
+    for (uint32_t i = 0; i < INPUT_RING_SIZE; i++) {
+        TEST_CHECK(input_ring_push(&r, i, INPUT_ENCODER, 0, 1), "push %u", i);
+    }
+    for (uint32_t i = 0; i < 10; i++) {
+        TEST_CHECK(!input_ring_push(&r, 1000 + i, INPUT_ENCODER, 0, 1), "push into a full ring");
+    }
+    TEST_CHECK(r.overflows == 10, "overflows %u", r.overflows);
+    TEST_CHECK(r.high_water == INPUT_RING_SIZE, "high water %u", r.high_water);
+
+    /*  The queued events survive, in order, and the ring takes more once drained  */
+    for (uint32_t i = 0; i < INPUT_RING_SIZE; i++) {
+        TEST_CHECK(input_ring_pop(&r, &e) && e.time_us == i, "pop %u got %u", i, e.time_us);
+    }
+    TEST_CHECK(input_ring_push(&r, 2000, INPUT_ENCODER, 0, 1), "push after drain");
+    TEST_CHECK(input_ring_pop(&r, &e) && e.time_us == 2000, "pop after drain");
+}
+
+/* ---------------------------------------------------------------------- */
+
+static input_ring_t stress_ring;
+static volatile bool stress_done;
+
+/*  time_us carries a sequence number, device and value are derived from it.
+ *  Bursts longer than the ring come between gaps long enough to drain it,
+ *  like fast spins of every encoder at once.  */
+static void *s_producer(void *arg)
+{
+    uint32_t *accepted = (uint32_t *) arg;
+
+    for (uint32_t seq = 0; seq < STRESS_EVENTS; ) {
+        for (uint32_t n = 0; n < STRESS_BURST && seq < STRESS_EVENTS; n++, seq++) {
+            *accepted += input_ring_push(&stress_ring, seq, INPUT_ENCODER, seq % 4,
+                    seq & 1 ? -1 : 1
+                    );
+        }
+        while (!input_ring_empty(&stress_ring)) {
+            sched_yield();
+        }
+    }
+    stress_done = true;
+    return NULL;
+}
+
+static void s_check_stress()
+{
+    pthread_t producer;
+    uint32_t accepted = 0, received = 0, last = 0;
+    bool first = true;
+    input_event_t e = { 0 };
+
+    uint64_t start = test_now_ns();
+    pthread_create(&producer, NULL, s_producer, &accepted);
+    for (;;) {
+        bool done = stress_done;
+        while (input_ring_pop(&stress_ring, &e)) {
+            TEST_CHECK(first || e.time_us > last, "event %u after %u", e.time_us, last);
+            TEST_CHECK(e.device == e.time_us % 4 && e.value == ( e.time_us & 1 ? -1 : 1 ),
+                    "event %u torn: %u/%d", e.time_us, e.device, e.value
+                    );
+            last = e.time_us;
+            first = false;
+            received++;
+            if (test_failures > 10) {
+                break;
+            }
+        }
+        if (done || test_failures > 10) {
+            break;
+        }
+        sched_yield();
+    }
+    pthread_join(producer, NULL);
+    while (input_ring_pop(&stress_ring, &e)) {
+        received++;
+    }
+    double ns = (double) ( test_now_ns() - start ) / STRESS_EVENTS;
+
+    TEST_CHECK(received == accepted, "received %u of %u accepted", received, accepted);
+    TEST_CHECK(accepted + stress_ring.overflows == STRESS_EVENTS, "accepted %u, dropped %u",
+            accepted, stress_ring.overflows
+            );
+    TEST_CHECK(stress_ring.high_water <= INPUT_RING_SIZE, "high water %u", stress_ring.high_water);
+    printf("stress:  %u events, %u dropped, high water %u, %.1f ns per event\n",
+            STRESS_EVENTS, stress_ring.overflows, stress_ring.high_water, ns
+            );
+}
+
+int main()
+{
+    s_check_order();
+    s_check_wrap();
+    s_check_overflow();
+    s_check_stress();
+
+    return test_result();
+}
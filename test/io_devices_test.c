@@ -0,0 +1,137 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** @file io_devices_test.c
+ *
+ *  A host model of the io_devices_8 debounce in io_devices.pio, one step per
+ *  sample, with the instruction cycles it takes.  Bounce shorter than the
+ *  stable-sample count must never be pushed, and a change that holds must be
+ *  pushed exactly once, for every count the pull threshold allows.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "test.h"
+
+#define PIO_THRESHOLD_MAX 32  /*  sm_config_set_out_shift() takes 1-32  */
+#define PIO_CLOCK_MHZ 1       /*  io_devices_8_program_init() runs at ~1MHz  */
+
+typedef struct io_devices_model {
+    uint8_t y;             /*  The pushed state  */
+    uint8_t shifted;       /*  Output shift count:  samples in the run  */
+    uint8_t threshold;     /*  Pull threshold:  RE_STABLE_SAMPLES or BUTTON_STABLE_SAMPLES  */
+    uint32_t cycles;
+    uint32_t pushes;
+    uint32_t fifo;         /*  Last word pushed  */
+} io_devices_model_t;
+
+/*  One pass through sample:, as the program runs it  */
+static void s_sample(io_devices_model_t *m, uint8_t pins)
+{
+    uint8_t x = pins;                     /*  mov isr, null / in pins, 8 / mov x, isr  */
+    m->cycles += 4;                       /*  ... and jmp x!=y, differs  */
+    if (x == m->y) {
+        m->cycles += 2;                   /*  jmp again / mov osr, null  */
+        m->shifted = 0;
+        return;
+    }
+    m->shifted++;                         /*  out null, 1  */
+    m->cycles += 1 + 1 + 25;              /*  ... and jmp !osre, sample [25]  */
+    if (m->shifted < m->threshold) {
+        return;
+    }
+    m->fifo = (uint32_t) x << 8 | m->y;   /*  mov isr, null / in x, 8 / in y, 8 / push  */
+    m->pushes++;
+    m->y = x;                             /*  mov y, x  */
+    m->shifted = 0;                       /*  .wrap to mov osr, null  */
+    m->cycles += 5 + 1;
+}
+
+/*  Runs of every length short of the threshold, back at the pushed state between  */
+static void s_check_bounce(uint8_t threshold)
+{
+    io_devices_model_t m = { .threshold = threshold };
+
+    for (uint8_t run = 1; run < threshold; run++) {
+        for (uint8_t i = 0; i < run; i++) {
+            s_sample(&m, i & 1 ? 0x01 : 0x03);
+        }
+        s_sample(&m, 0x00);
+    }
+    for (uint32_t i = 0; i < 100000; i++) {
+        uint8_t run = 1 + rand() % threshold;
+        for (uint8_t j = 1; j < run; j++) {
+            s_sample(&m, 1 + rand() % 0xff);
+        }
+        s_sample(&m, 0x00);
+    }
+    TEST_CHECK(m.pushes == 0, "threshold %u pushed %u bounces", threshold, m.pushes);
+    TEST_CHECK(m.y == 0x00, "threshold %u moved to %02x", threshold, m.y);
+}
+
+/*  Bounce, then settle on a new state and hold it  */
+static void s_check_stable(uint8_t threshold)
+{
+    io_devices_model_t m = { .threshold = threshold };
+
+    for (uint32_t i = 0; i < 50; i++) {
+        uint8_t run = 1 + rand() % threshold;
+        for (uint8_t j = 1; j < run; j++) {
+            s_sample(&m, 0x02);
+        }
+        s_sample(&m, 0x00);
+    }
+    TEST_CHECK(m.pushes == 0, "threshold %u pushed while bouncing", threshold);
+
+    uint32_t settled = m.cycles;
+    uint32_t reported = 0;
+    for (uint32_t i = 0; i < 1000; i++) {
+        s_sample(&m, 0x02);
+        if (m.pushes && !reported) {
+            reported = m.cycles;
+        }
+    }
+    TEST_CHECK(m.pushes == 1, "threshold %u pushed a held change %u times", threshold, m.pushes);
+    TEST_CHECK(m.fifo == 0x0200, "threshold %u pushed %04x", threshold, m.fifo);
+
+    /*  ~32us a sample, as the CMake comments promise  */
+    uint32_t us = ( reported - settled ) / PIO_CLOCK_MHZ;
+    TEST_CHECK(us <= threshold * 32u + 8u, "threshold %u reported after %u us", threshold, us);
+
+    /*  And back, once  */
+    for (uint32_t i = 0; i < 1000; i++) {
+        s_sample(&m, 0x00);
+    }
+    TEST_CHECK(m.pushes == 2 && m.fifo == 0x0002, "threshold %u release: %u pushes, %04x",
+            threshold, m.pushes, m.fifo
+            );
+}
+
+int main()
+{
+    srand(2022);
+    for (uint8_t threshold = 1; threshold <= PIO_THRESHOLD_MAX; threshold++) {
+        s_check_bounce(threshold);
+        s_check_stable(threshold);
+    }
+
+    return test_result();
+}
@@ -0,0 +1,225 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** @file ssd1306_test.c
+ *
+ *  The SSD1306 driver on the mock transport:  the command bytes of the init
+ *  sequence, then the addressing and data bytes of full and shadow-diffed
+ *  updates, merged runs, a scrolled panel and a log too small to keep up.
+ *  The mock records each write as its I2C control byte, 0x00 ahead of
+ *  commands and 0x40 ahead of data, then the bytes.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "ssd1306.h"
+
+#define LOG_SIZE 4096
+
+/*  Expect the next bytes of the log, and step past them  */
+static size_t s_expect(ssd1306_t *p, size_t at, const uint8_t *want, size_t len, const char *what)
+{
+    TEST_CHECK(at + len <= p->mock_len, "%s: log ends at %zu, wanted %zu more at %zu", what,
+            p->mock_len, len, at
+            );
+    if (at + len <= p->mock_len) {
+        for (size_t i = 0; i < len; i++) {
+            if (p->mock_log[at + i] != want[i]) {
+                TEST_CHECK(p->mock_log[at + i] == want[i], "%s: byte %zu is %02x, wanted %02x",
+                        what, i, p->mock_log[at + i], want[i]
+                        );
+                break;
+            }
+        }
+    }
+    return at + len;
+}
+
+/*  One span:  column and page addressing, then its data from the buffer  */
+static size_t s_expect_span(ssd1306_t *p, size_t at, uint8_t ram_page, uint8_t pages,
+        uint8_t page, uint8_t x0, uint8_t x1)
+{
+    const uint8_t cmds[] = { 0x00, SET_COL_ADDR, x0, x1, SET_PAGE_ADDR, ram_page,
+                             ram_page + pages - 1 };
+    at = s_expect(p, at, cmds, sizeof( cmds ), "span addressing");
+
+    const uint8_t control = 0x40;
+    at = s_expect(p, at, &control, 1, "span control byte");
+    return s_expect(p, at, p->buffer + page * p->width + x0,
+            ( pages - 1 ) * p->width + x1 - x0 + 1, "span data"
+            );
+}
+
+static void s_check_init()
+{
+    ssd1306_t p = { 0 };
+
+    TEST_CHECK(ssd1306_init_mock(&p, 128, 32, LOG_SIZE), "init");
+    const uint8_t want[] = {
+        0x00,
+        SET_DISP | 0x00,
+        SET_MEM_ADDR, 0x00,
+        SET_DISP_START_LINE | 0x00,
+        SET_SEG_REMAP | 0x01,
+        SET_MUX_RATIO, 31,
+        SET_COM_OUT_DIR | 0x08,
+        SET_DISP_OFFSET, 0x00,
+        SET_COM_PIN_CFG, 0x02,
+        SET_DISP_CLK_DIV, 0x80,
+        SET_PRECHARGE, 0xF1,
+        SET_VCOM_DESEL, 0x30,
+        SET_CONTRAST, 0xFF,
+        SET_ENTIRE_ON,
+        SET_NORM_INV,
+        SET_CHARGE_PUMP, 0x14,
+        SET_DISP | 0x01,
+    };
+    size_t at = s_expect(&p, 0, want, sizeof( want ), "init");
+    TEST_CHECK(at == p.mock_len, "init sent %zu bytes, wanted %zu", p.mock_len, at);
+    TEST_CHECK(p.mock_dropped == 0, "init dropped %u bytes", p.mock_dropped);
+    ssd1306_deinit(&p);
+
+    /*  A 64-line panel takes the alternative COM pin layout  */
+    TEST_CHECK(ssd1306_init_mock(&p, 128, 64, LOG_SIZE), "init 128x64");
+    TEST_CHECK(p.mock_log[7] == 63 && p.mock_log[12] == 0x12, "128x64 mux %u, COM pins %02x",
+            p.mock_log[7], p.mock_log[12]
+            );
+    ssd1306_deinit(&p);
+}
+
+static void s_check_updates()
+{
+    ssd1306_t p = { 0 };
+    size_t at;
+
+    ssd1306_init_mock(&p, 128, 32, LOG_SIZE);
+
+    /*  Nothing is known to be on the panel yet, so every page goes  */
+    ssd1306_clear(&p);
+    ssd1306_mock_reset(&p);
+    ssd1306_show_changes(&p);
+    at = 0;
+    for (uint8_t page = 0; page < p.pages; page++) {
+        at = s_expect_span(&p, at, page, 1, page, 0, 127);
+    }
+    TEST_CHECK(at == p.mock_len, "first update sent %zu bytes, wanted %zu", p.mock_len, at);
+
+    /*  Unchanged:  nothing at all  */
+    ssd1306_mock_reset(&p);
+    ssd1306_show_changes(&p);
+    TEST_CHECK(p.mock_len == 0, "unchanged update sent %zu bytes", p.mock_len);
+
+    /*  One pixel:  one column of one page  */
+    ssd1306_draw_pixel(&p, 10, 9, true);
+    ssd1306_mock_reset(&p);
+    ssd1306_show_changes(&p);
+    const uint8_t one[] = { 0x00, SET_COL_ADDR, 10, 10, SET_PAGE_ADDR, 1, 1, 0x40, 0x02 };
+    at = s_expect(&p, 0, one, sizeof( one ), "one pixel");
+    TEST_CHECK(at == p.mock_len, "one pixel sent %zu bytes, wanted %zu", p.mock_len, at);
+
+    /*  Runs within SSD1306_SPAN_MERGE_GAP columns go as one, further apart as two  */
+    ssd1306_draw_pixel(&p, 20, 16, true);
+    ssd1306_draw_pixel(&p, 20 + SSD1306_SPAN_MERGE_GAP, 17, true);
+    ssd1306_draw_pixel(&p, 40, 24, true);
+    ssd1306_draw_pixel(&p, 40 + SSD1306_SPAN_MERGE_GAP + 1, 31, true);
+    ssd1306_mock_reset(&p);
+    ssd1306_show_changes(&p);
+    at = s_expect_span(&p, 0, 2, 1, 2, 20, 20 + SSD1306_SPAN_MERGE_GAP);
+    at = s_expect_span(&p, at, 3, 1, 3, 40, 40);
+    at = s_expect_span(&p, at, 3, 1, 3, 40 + SSD1306_SPAN_MERGE_GAP + 1,
+            40 + SSD1306_SPAN_MERGE_GAP + 1
+            );
+    TEST_CHECK(at == p.mock_len, "merged update sent %zu bytes, wanted %zu", p.mock_len, at);
+
+    /*  A full show is one span of every page  */
+    ssd1306_mock_reset(&p);
+    ssd1306_show(&p);
+    at = s_expect_span(&p, 0, 0, 4, 0, 0, 127);
+    TEST_CHECK(at == p.mock_len, "show sent %zu bytes, wanted %zu", p.mock_len, at);
+
+    ssd1306_deinit(&p);
+}
+
+/*  Scrolled up a page:  only the newly exposed page is sent, at its GDDRAM page  */
+static void s_check_scroll()
+{
+    ssd1306_t p = { 0 };
+
+    ssd1306_init_mock(&p, 128, 32, LOG_SIZE);
+    ssd1306_clear(&p);
+    ssd1306_show(&p);
+
+    ssd1306_mock_reset(&p);
+    ssd1306_scroll(&p, 1);
+    const uint8_t start_line[] = { 0x00, SET_DISP_START_LINE | 8 };
+    size_t at = s_expect(&p, 0, start_line, sizeof( start_line ), "scroll");
+    TEST_CHECK(at == p.mock_len, "scroll sent %zu bytes, wanted %zu", p.mock_len, at);
+
+    ssd1306_mock_reset(&p);
+    ssd1306_show_changes(&p);
+    at = s_expect_span(&p, 0, 4, 1, 3, 0, 127);
+    TEST_CHECK(at == p.mock_len, "scrolled update sent %zu bytes, wanted %zu", p.mock_len, at);
+
+    ssd1306_deinit(&p);
+}
+
+/*  A 64-column panel sits in the middle of the controller's 128 columns  */
+static void s_check_narrow()
+{
+    ssd1306_t p = { 0 };
+
+    ssd1306_init_mock(&p, 64, 32, LOG_SIZE);
+    ssd1306_clear(&p);
+    ssd1306_show(&p);
+    ssd1306_draw_pixel(&p, 0, 0, true);
+    ssd1306_mock_reset(&p);
+    ssd1306_show_changes(&p);
+    const uint8_t want[] = { 0x00, SET_COL_ADDR, 32, 32, SET_PAGE_ADDR, 0, 0, 0x40, 0x01 };
+    size_t at = s_expect(&p, 0, want, sizeof( want ), "narrow");
+    TEST_CHECK(at == p.mock_len, "narrow update sent %zu bytes, wanted %zu", p.mock_len, at);
+
+    ssd1306_deinit(&p);
+}
+
+/*  What does not fit is counted, not written past the end  */
+static void s_check_overflow()
+{
+    ssd1306_t p = { 0 };
+
+    ssd1306_init_mock(&p, 128, 32, 64);
+    ssd1306_mock_reset(&p);
+    ssd1306_show(&p);
+    TEST_CHECK(p.mock_len == 7, "kept %zu bytes, wanted the addressing only", p.mock_len);
+    TEST_CHECK(p.mock_dropped == 1 + 512, "dropped %u bytes", p.mock_dropped);
+
+    ssd1306_deinit(&p);
+}
+
+int main()
+{
+    s_check_init();
+    s_check_updates();
+    s_check_scroll();
+    s_check_narrow();
+    s_check_overflow();
+
+    return test_result();
+}
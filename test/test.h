@@ -0,0 +1,60 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TEST_H
+#define __TEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/** @file test.h
+ *
+ *  @brief Just enough for the host checks:  a failure counter and a clock.
+ */
+
+static unsigned test_failures;
+
+#define TEST_CHECK( cond, ... ) do { \
+        if ( !( cond ) ) { \
+            test_failures++; \
+            printf("%s:%d: %s: ", __FILE__, __LINE__, #cond); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+        } \
+} while (0)
+
+static inline uint64_t test_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/*  Keeps the optimizer from dropping work whose result is otherwise unused  */
+static volatile uint32_t test_sink;
+
+static inline int test_result()
+{
+    printf("%s\n", test_failures ? "FAILED" : "passed");
+    return test_failures ? 1 : 0;
+}
+
+#endif /* __TEST_H */
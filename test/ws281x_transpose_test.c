@@ -0,0 +1,117 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Jonathan Springer
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This file is part of pico-color-picker.
+ *
+ * pico-color-picker is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * pico-color-picker is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * pico-color-picker. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** @file ws281x_transpose_test.c
+ *
+ *  Checks ws281x_transpose8() against a bit-at-a-time transpose, then times
+ *  both over a chunk's worth of LEDs at a time.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "ws281x_transpose.h"
+
+#define BENCH_LEDS 8  /*  WS281X_PARALLEL_CHUNK  */
+#define BENCH_ROUNDS 200000
+
+static void s_transpose_reference(const uint8_t *in, uint8_t *out)
+{
+    memset(out, 0, 8);
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        for (uint8_t lane = 0; lane < 8; lane++) {
+            if ( in[7 - lane] & ( 0x80u >> bit ) ) {
+                out[bit] |= 1u << lane;
+            }
+        }
+    }
+}
+
+static void s_check_one(const uint8_t *in)
+{
+    uint8_t got[8], want[8];
+
+    ws281x_transpose8(in, got);
+    s_transpose_reference(in, want);
+    TEST_CHECK(memcmp(got, want, 8) == 0,
+            "in %02x%02x%02x%02x%02x%02x%02x%02x", in[0], in[1], in[2], in[3],
+            in[4], in[5], in[6], in[7]
+            );
+}
+
+static void s_check()
+{
+    uint8_t in[8];
+
+    /*  Every single lit bit, then every byte value in every lane  */
+    for (uint8_t i = 0; i < 64; i++) {
+        memset(in, 0, 8);
+        in[i / 8] = 0x80u >> ( i % 8 );
+        s_check_one(in);
+    }
+    for (uint8_t lane = 0; lane < 8; lane++) {
+        for (uint32_t v = 0; v < 256; v++) {
+            memset(in, 0x5A, 8);
+            in[lane] = v;
+            s_check_one(in);
+        }
+    }
+    srand(1);
+    for (uint32_t n = 0; n < 100000; n++) {
+        for (uint8_t i = 0; i < 8; i++) {
+            in[i] = rand();
+        }
+        s_check_one(in);
+    }
+}
+
+static double s_bench(void ( *f )(const uint8_t *, uint8_t *), const uint8_t *lanes)
+{
+    uint8_t planes[BENCH_LEDS * 24];
+
+    uint64_t start = test_now_ns();
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+        for (uint8_t led = 0; led < BENCH_LEDS; led++) {
+            /*  G, R and B planes of one LED, as the parallel expander does  */
+            f(lanes + led * 24, planes + led * 24);
+            f(lanes + led * 24 + 8, planes + led * 24 + 8);
+            f(lanes + led * 24 + 16, planes + led * 24 + 16);
+        }
+        test_sink += planes[round % sizeof( planes )];
+    }
+    return (double) ( test_now_ns() - start ) / ( (double) BENCH_ROUNDS * BENCH_LEDS );
+}
+
+int main()
+{
+    uint8_t lanes[BENCH_LEDS * 24];
+
+    s_check();
+
+    for (uint32_t i = 0; i < sizeof( lanes ); i++) {
+        lanes[i] = i * 37;
+    }
+    printf("transpose, ns per LED:  kernel %.1f  reference %.1f\n",
+            s_bench(ws281x_transpose8, lanes), s_bench(s_transpose_reference, lanes)
+            );
+
+    return test_result();
+}